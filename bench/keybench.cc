@@ -0,0 +1,204 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* keybench - measures the throughput and latency of key injection, meant to
+ * run against Xvfb. It focuses a window of its own, types bursts of keys
+ * into it through KeyInjector and times each key from the flush of its burst
+ * to the arrival of its KeyPress event. The keys mix keysyms of the keyboard
+ * mapping with greek ones, which have to be remapped onto spare keycodes, and
+ * every received key is checked against the one typed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <vector>
+#include <algorithm>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include "keyinject.h"
+#include "timer.h"
+
+#define EVENT_TIMEOUT	2000	/* msec */
+
+static KeySym keyset[] = {
+	XK_a, XK_b, XK_c, XK_x, XK_y, XK_z, XK_A, XK_Z,
+	XK_space, XK_BackSpace, XK_Return,
+	XK_Greek_alpha, XK_Greek_beta, XK_Greek_gamma, XK_Greek_ALPHA, XK_Greek_OMEGA
+};
+#define KEYSET_SIZE	((int)(sizeof keyset / sizeof *keyset))
+
+static long num_keys = 2000;
+static int burst = 8;
+
+static Display *dpy;
+static KeyInjector injector;
+
+static int parse_args(int argc, char **argv);
+static Window create_target();
+static bool next_event(XEvent *ev);
+
+int main(int argc, char **argv)
+{
+	std::vector<float> latency;
+	std::vector<KeySym> expected;
+	long mismatched = 0;
+
+	if(parse_args(argc, argv) == -1) {
+		return 1;
+	}
+
+	if(!(dpy = XOpenDisplay(0))) {
+		fprintf(stderr, "failed to connect to the X server\n");
+		return 1;
+	}
+	if(!create_target() || !injector.init(dpy)) {
+		return 1;
+	}
+
+	latency.reserve(num_keys);
+	uint64_t start = get_usec();
+
+	for(long typed=0; typed<num_keys; ) {
+		int count = std::min<long>(burst, num_keys - typed);
+
+		expected.clear();
+		for(int i=0; i<count; i++) {
+			KeySym sym = keyset[(typed + i) % KEYSET_SIZE];
+			injector.type(sym);
+			expected.push_back(sym);
+		}
+		injector.flush();
+		uint64_t t0 = get_usec();
+
+		for(int received=0; received<count; ) {
+			XEvent ev;
+			if(!next_event(&ev)) {
+				fprintf(stderr, "timed out waiting for key %ld, is the window focused?\n",
+						typed + received);
+				return 1;
+			}
+			if(injector.handle_event(&ev) || ev.type != KeyPress) {
+				continue;
+			}
+
+			char buf[16];
+			KeySym sym;
+			XLookupString(&ev.xkey, buf, sizeof buf, &sym, 0);
+			if(IsModifierKey(sym)) {
+				continue;
+			}
+
+			latency.push_back((get_usec() - t0) / 1000.0);
+			if(sym != expected[received]) {
+				mismatched++;
+			}
+			received++;
+		}
+		typed += count;
+	}
+	unsigned long usec = get_usec() - start;
+
+	std::sort(latency.begin(), latency.end());
+	double sum = 0.0;
+	for(size_t i=0; i<latency.size(); i++) {
+		sum += latency[i];
+	}
+
+	printf("keys: %ld in bursts of %d\n", num_keys, burst);
+	printf("throughput: %.0f keys/s\n", num_keys * 1000000.0 / usec);
+	printf("latency: %.3f ms mean, %.3f ms p99, %.3f ms max (flush to KeyPress)\n",
+			sum / latency.size(), latency[latency.size() * 99 / 100], latency.back());
+	printf("mismatched keys: %ld\n", mismatched);
+	injector.print_stats(stdout);
+
+	XCloseDisplay(dpy);
+	return mismatched ? 1 : 0;
+}
+
+/* a mapped window with the input focus, to type into */
+static Window create_target()
+{
+	Window win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 64, 64, 0, 0, 0);
+	XSelectInput(dpy, win, KeyPressMask | KeyReleaseMask | StructureNotifyMask);
+	XMapWindow(dpy, win);
+
+	XEvent ev;
+	do {
+		if(!next_event(&ev)) {
+			fprintf(stderr, "timed out waiting for the window to be mapped\n");
+			return 0;
+		}
+	} while(ev.type != MapNotify);
+
+	XSetInputFocus(dpy, win, RevertToParent, CurrentTime);
+	XSync(dpy, False);
+	return win;
+}
+
+static bool next_event(XEvent *ev)
+{
+	while(!XPending(dpy)) {
+		struct pollfd pfd = {ConnectionNumber(dpy), POLLIN, 0};
+		if(poll(&pfd, 1, EVENT_TIMEOUT) <= 0) {
+			return false;
+		}
+	}
+	XNextEvent(dpy, ev);
+	return true;
+}
+
+static int parse_args(int argc, char **argv)
+{
+	for(int i=1; i<argc; i++) {
+		if(argv[i][0] == '-' && argv[i][2] == 0) {
+			switch(argv[i][1]) {
+			case 'n':
+				if(!argv[++i] || (num_keys = atol(argv[i])) <= 0) {
+					fprintf(stderr, "-n must be followed by a positive number of keys\n");
+					return -1;
+				}
+				break;
+
+			case 'b':
+				if(!argv[++i] || (burst = atoi(argv[i])) <= 0) {
+					fprintf(stderr, "-b must be followed by a positive burst size\n");
+					return -1;
+				}
+				break;
+
+			case 'h':
+				printf("usage: %s [options]\n", argv[0]);
+				printf("options:\n");
+				printf(" -n <keys>    keys to type (default %ld)\n", num_keys);
+				printf(" -b <keys>    keys per flush (default %d)\n", burst);
+				printf(" -h           print usage and exit\n");
+				exit(0);
+
+			default:
+				fprintf(stderr, "invalid option: %s\n", argv[i]);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,592 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* mbench - runs the capture/motion pipeline headless over a replayed or
+ * synthetic frame source and reports throughput, per-stage latency and
+ * direction accuracy against ground truth.
+ *
+ * -S runs a suite of synthetic sequences (textured background with a patch
+ * translating at known velocities, at several noise levels). With -o the
+ * suite results are saved as a baseline, and with -b they are compared
+ * against one, and mbench fails if accuracy, flow cost or throughput
+ * regressed. -e all runs the suite once per motion engine, to compare them.
+ *
+ * -J measures how the tiled lk engine scales with the number of threads.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+#include "motion.h"
+#include "frmsrc.h"
+
+/* regression tolerances of the baseline comparison */
+#define MAX_ACCURACY_DROP	2.0		/* percentage points */
+#define MAX_FLOW_SLOWDOWN	1.25
+#define MAX_FPS_DROP		0.8
+
+struct Scenario {
+	const char *name;
+	float vel;		/* patch velocity, pixels per frame */
+	float noise;	/* noise sigma, gray levels */
+};
+
+static Scenario suite[] = {
+	{"static",		0.0, 2.0},
+	{"slow",		2.0, 2.0},
+	{"medium",		6.0, 2.0},
+	{"fast",		14.0, 2.0},
+	{"very-fast",	24.0, 2.0},
+	{"noisy",		6.0, 8.0},
+	{"very-noisy",	6.0, 16.0}
+};
+#define SUITE_SIZE	((int)(sizeof suite / sizeof *suite))
+
+struct FrameRec {
+	float stage_ms[NUM_STAGES];
+	float latency_ms;
+};
+
+struct Result {
+	const char *name;
+	float fps;
+	float accuracy;		/* percent, or -1 if there is no ground truth */
+	float flow_p50;
+	float latency_p50;
+};
+
+static const char *stage_name[] = {"grab", "prep", "flow", "publish"};
+
+static const char *src_spec = "synth";
+static PaceMode src_pace = PACE_FAST;
+static long max_frames = 300;
+static bool scale_sweep, thread_sweep, run_suite, all_engines;
+static const char *baseline_out, *baseline_in;
+
+static const float sweep_scales[] = {1.0, 0.75, 0.5, 0.35, 0.25, 0.125};
+
+static std::vector<FrameRec> frames;
+
+static int parse_args(int argc, char **argv);
+static bool run(FrameSource *src, MotionStats *st);
+static FrameSource *open_source(float vel, float noise);
+static void frame_done(const FramePacket *pkt);
+static float percentile(std::vector<float> &v, float p);
+static int do_suite();
+static bool suite_engine(Result *res);
+static int do_sweep();
+static int do_thread_sweep();
+static bool save_baseline(const char *fname, const Result *res, int count);
+static int compare_baseline(const char *fname, const Result *res, int count);
+
+int main(int argc, char **argv)
+{
+	MotionStats st;
+	FrameSource *src;
+
+	/* measure every frame, at fixed quality, unless asked otherwise */
+	motion_params.drop = DROP_NONE;
+	motion_params.frame_budget = 0.0;
+
+	if(parse_args(argc, argv) == -1) {
+		return 1;
+	}
+	motion_frame_cb = frame_done;
+
+	if(run_suite) {
+		return do_suite();
+	}
+	if(scale_sweep) {
+		return do_sweep();
+	}
+	if(thread_sweep) {
+		return do_thread_sweep();
+	}
+
+	printf("source: %s (%s)\n", src_spec, src_pace == PACE_FAST ? "fast" : "real time");
+	if(!(src = open_source(8.0, 2.0)) || !run(src, &st)) {
+		return 1;
+	}
+	print_motion_stats(stdout, &st);
+	return 0;
+}
+
+static FrameSource *open_source(float vel, float noise)
+{
+	FrameSource *src;
+
+	if(strcmp(src_spec, "synth") == 0) {
+		return new SynthSource(640, 480, vel, noise, max_frames, src_pace);
+	}
+
+	if(!(src = create_frame_source(src_spec, src_pace))) {
+		fprintf(stderr, "failed to open frame source: %s\n", src_spec);
+	}
+	return src;
+}
+
+static bool run(FrameSource *src, MotionStats *st)
+{
+	uint64_t count;
+
+	frames.clear();
+	if(!start_capture(src)) {
+		return false;
+	}
+
+	/* drain wakeups until the capture thread signals the end of the stream */
+	while(read(notify_fd, &count, sizeof count) == sizeof count && count < NOTIFY_EOS);
+	pthread_join(ptd, 0);
+	close(notify_fd);
+
+	*st = motion_stats;
+	return st->num_frames > 0;
+}
+
+/* runs in the capture thread, frames is only read after it's joined */
+static void frame_done(const FramePacket *pkt)
+{
+	FrameRec rec;
+
+	for(int i=0; i<NUM_STAGES; i++) {
+		rec.stage_ms[i] = pkt->usec[i] / 1000.0;
+	}
+	rec.latency_ms = (pkt->t_publish - pkt->t_grab) / 1000.0;
+	frames.push_back(rec);
+}
+
+static float percentile(std::vector<float> &v, float p)
+{
+	if(v.empty()) {
+		return 0.0;
+	}
+	size_t idx = (size_t)(p / 100.0 * (v.size() - 1) + 0.5);
+	std::nth_element(v.begin(), v.begin() + idx, v.end());
+	return v[idx];
+}
+
+static int do_suite()
+{
+	Result res[SUITE_SIZE];
+
+	printf("%d frames per sequence, times in ms\n", (int)max_frames);
+
+	if(all_engines) {
+		for(int i=0; motion_engine_names[i]; i++) {
+			motion_params.engine = motion_engine_names[i];
+			if(!suite_engine(res)) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	if(!suite_engine(res)) {
+		return 1;
+	}
+	if(baseline_out && !save_baseline(baseline_out, res, SUITE_SIZE)) {
+		return 1;
+	}
+	if(baseline_in) {
+		return compare_baseline(baseline_in, res, SUITE_SIZE);
+	}
+	return 0;
+}
+
+/* runs the suite with the current motion engine */
+static bool suite_engine(Result *res)
+{
+	std::vector<float> samples[NUM_STAGES + 1];
+	MotionStats st;
+
+	printf("\nengine: %s\n", motion_params.engine);
+	printf("%-11s %7s %7s | %-20s |", "sequence", "fps", "acc%", "latency p50/p90/p99");
+	for(int i=0; i<NUM_STAGES; i++) {
+		printf(" %-7s p50/p99 |", stage_name[i]);
+	}
+	putchar('\n');
+
+	for(int i=0; i<SUITE_SIZE; i++) {
+		FrameSource *src = new SynthSource(640, 480, suite[i].vel, suite[i].noise,
+				max_frames, PACE_FAST);
+		if(!run(src, &st)) {
+			fprintf(stderr, "sequence %s produced no frames\n", suite[i].name);
+			return false;
+		}
+
+		for(int j=0; j<=NUM_STAGES; j++) {
+			samples[j].clear();
+		}
+		for(size_t j=0; j<frames.size(); j++) {
+			for(int k=0; k<NUM_STAGES; k++) {
+				samples[k].push_back(frames[j].stage_ms[k]);
+			}
+			samples[NUM_STAGES].push_back(frames[j].latency_ms);
+		}
+
+		res[i].name = suite[i].name;
+		res[i].fps = st.num_frames * 1000000.0 / st.wall_usec;
+		res[i].accuracy = st.num_truth ? 100.0 * st.num_correct / st.num_truth : -1.0;
+		res[i].flow_p50 = percentile(samples[STAGE_FLOW], 50);
+		res[i].latency_p50 = percentile(samples[NUM_STAGES], 50);
+
+		printf("%-11s %7.1f %7.1f | %6.2f %6.2f %6.2f |", res[i].name, res[i].fps,
+				res[i].accuracy, res[i].latency_p50, percentile(samples[NUM_STAGES], 90),
+				percentile(samples[NUM_STAGES], 99));
+		for(int k=0; k<NUM_STAGES; k++) {
+			printf(" %7.3f %7.3f |", percentile(samples[k], 50), percentile(samples[k], 99));
+		}
+		putchar('\n');
+	}
+	return true;
+}
+
+/* cost versus accuracy at each processing scale */
+static int do_sweep()
+{
+	MotionStats st;
+	FrameSource *src;
+
+	printf("source: %s (%s)\n", src_spec, src_pace == PACE_FAST ? "fast" : "real time");
+	printf("scale   fps      latency   flow ms   accuracy\n");
+	for(size_t i=0; i<sizeof sweep_scales / sizeof *sweep_scales; i++) {
+		motion_params.proc_scale = sweep_scales[i];
+		if(!(src = open_source(8.0, 2.0)) || !run(src, &st)) {
+			return 1;
+		}
+
+		printf("%-6.3f  %-7.2f  %-8.3f  %-8.3f  ", sweep_scales[i],
+				st.num_frames * 1000000.0 / st.wall_usec,
+				st.latency_usec / 1000.0 / st.num_frames,
+				st.stage_usec[STAGE_FLOW] / 1000.0 / st.num_frames);
+		if(st.num_truth) {
+			printf("%.1f%%\n", 100.0 * st.num_correct / st.num_truth);
+		} else {
+			printf("-\n");
+		}
+	}
+	return 0;
+}
+
+/* scaling of the tiled lk engine with the number of threads */
+static int do_thread_sweep()
+{
+	MotionStats st;
+	FrameSource *src;
+	int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	float base_flow = 0.0;
+
+	motion_params.engine = "lk";
+	if(motion_params.tiles <= 1) {
+		motion_params.tiles = 4;
+	}
+
+	printf("source: %s (%s), %dx%d tiles\n", src_spec, src_pace == PACE_FAST ? "fast" : "real time",
+			motion_params.tiles, motion_params.tiles);
+	printf("threads  fps      flow ms   speedup  accuracy\n");
+	for(int t=1; ; t*=2) {
+		if(t > ncpu) t = ncpu;
+		motion_params.threads = t;
+		if(!(src = open_source(8.0, 2.0)) || !run(src, &st)) {
+			return 1;
+		}
+
+		float flow = st.stage_usec[STAGE_FLOW] / 1000.0 / st.num_frames;
+		if(t == 1) base_flow = flow;
+
+		printf("%-7d  %-7.2f  %-8.3f  %-7.2f  ", t, st.num_frames * 1000000.0 / st.wall_usec,
+				flow, base_flow / flow);
+		if(st.num_truth) {
+			printf("%.1f%%\n", 100.0 * st.num_correct / st.num_truth);
+		} else {
+			printf("-\n");
+		}
+		if(t >= ncpu) break;
+	}
+	return 0;
+}
+
+static bool save_baseline(const char *fname, const Result *res, int count)
+{
+	FILE *fp;
+
+	if(!(fp = fopen(fname, "w"))) {
+		perror("failed to write baseline");
+		return false;
+	}
+	fprintf(fp, "# sequence accuracy flow_p50 latency_p50 fps\n");
+	for(int i=0; i<count; i++) {
+		fprintf(fp, "%s %.2f %.4f %.4f %.2f\n", res[i].name, res[i].accuracy,
+				res[i].flow_p50, res[i].latency_p50, res[i].fps);
+	}
+	fclose(fp);
+	printf("\nbaseline saved to %s\n", fname);
+	return true;
+}
+
+static int compare_baseline(const char *fname, const Result *res, int count)
+{
+	FILE *fp;
+	char line[256], name[64];
+	float acc, flow, lat, fps;
+	int regressions = 0, missing = 0;
+	std::vector<bool> found(count, false);
+
+	if(!(fp = fopen(fname, "r"))) {
+		perror("failed to read baseline");
+		return 1;
+	}
+
+	printf("\ncomparing against %s\n", fname);
+	while(fgets(line, sizeof line, fp)) {
+		if(line[0] == '#' || sscanf(line, "%63s %f %f %f %f", name, &acc, &flow, &lat, &fps) != 5) {
+			continue;
+		}
+
+		for(int i=0; i<count; i++) {
+			if(strcmp(res[i].name, name) != 0) {
+				continue;
+			}
+			found[i] = true;
+
+			if(acc >= 0.0 && res[i].accuracy < acc - MAX_ACCURACY_DROP) {
+				printf("  %s: accuracy regressed %.1f%% -> %.1f%%\n", name, acc, res[i].accuracy);
+				regressions++;
+			}
+			if(res[i].flow_p50 > flow * MAX_FLOW_SLOWDOWN) {
+				printf("  %s: flow p50 regressed %.3f -> %.3f ms\n", name, flow, res[i].flow_p50);
+				regressions++;
+			}
+			if(res[i].fps < fps * MAX_FPS_DROP) {
+				printf("  %s: throughput regressed %.1f -> %.1f fps\n", name, fps, res[i].fps);
+				regressions++;
+			}
+		}
+	}
+	fclose(fp);
+
+	/* a sequence the baseline doesn't cover would pass unchecked */
+	for(int i=0; i<count; i++) {
+		if(!found[i]) {
+			printf("  %s: not in the baseline\n", res[i].name);
+			missing++;
+		}
+	}
+	if(missing) {
+		printf("%d sequence(s) missing from the baseline\n", missing);
+	}
+	if(regressions) {
+		printf("%d regression(s)\n", regressions);
+	}
+	if(missing || regressions) {
+		return 1;
+	}
+	printf("no regressions\n");
+	return 0;
+}
+
+static int parse_args(int argc, char **argv)
+{
+	for(int i=1; i<argc; i++) {
+		if(argv[i][0] == '-' && argv[i][2] == 0) {
+			switch(argv[i][1]) {
+			case 's':
+				if(!argv[++i]) {
+					fprintf(stderr, "-s must be followed by a frame source\n");
+					return -1;
+				}
+				src_spec = argv[i];
+				break;
+
+			case 'n':
+				if(!argv[++i] || (max_frames = atol(argv[i])) <= 0) {
+					fprintf(stderr, "-n must be followed by a positive frame count\n");
+					return -1;
+				}
+				break;
+
+			case 'r':
+				src_pace = PACE_REALTIME;
+				break;
+
+			case 'l':
+				if(!argv[++i] || (motion_params.pyr_levels = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-l must be followed by the number of pyramid levels\n");
+					return -1;
+				}
+				break;
+
+			case 'w':
+				if(!argv[++i] || (motion_params.win_size = atoi(argv[i])) < 3) {
+					fprintf(stderr, "-w must be followed by a window size of at least 3\n");
+					return -1;
+				}
+				break;
+
+			case 'd':
+				if(!argv[++i] || (motion_params.proc_scale = atof(argv[i])) <= 0.0) {
+					fprintf(stderr, "-d must be followed by a processing scale in (0, 1]\n");
+					return -1;
+				}
+				break;
+
+			case 'R':
+				if(!argv[++i] || parse_roi(argv[i], &motion_params.roi) == -1) {
+					fprintf(stderr, "-R must be followed by a region of interest: x,y,w,h\n");
+					return -1;
+				}
+				break;
+
+			case 'D':
+				scale_sweep = true;
+				break;
+
+			case 'J':
+				thread_sweep = true;
+				break;
+
+			case 'S':
+				run_suite = true;
+				break;
+
+			case 'o':
+				if(!(baseline_out = argv[++i])) {
+					fprintf(stderr, "-o must be followed by a file name\n");
+					return -1;
+				}
+				break;
+
+			case 'b':
+				if(!(baseline_in = argv[++i])) {
+					fprintf(stderr, "-b must be followed by a file name\n");
+					return -1;
+				}
+				break;
+
+			case 'P':
+				if(!argv[++i]) {
+					fprintf(stderr, "-P must be followed by a drop policy\n");
+					return -1;
+				}
+				if(strcmp(argv[i], "none") == 0) {
+					motion_params.drop = DROP_NONE;
+				} else if(strcmp(argv[i], "stale") == 0) {
+					motion_params.drop = DROP_STALE;
+				} else {
+					fprintf(stderr, "invalid drop policy: %s\n", argv[i]);
+					return -1;
+				}
+				break;
+
+			case 'G':
+				motion_params.gate = false;
+				break;
+
+			case 'H':
+				motion_params.segment = true;
+				break;
+
+			case 'T':
+				if(!argv[++i] || (motion_params.tiles = atoi(argv[i])) < 1) {
+					fprintf(stderr, "-T must be followed by the number of tiles per side\n");
+					return -1;
+				}
+				break;
+
+			case 'j':
+				if(!argv[++i] || (motion_params.threads = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-j must be followed by the number of threads (0: one per CPU)\n");
+					return -1;
+				}
+				break;
+
+			case 'B':
+				if(!argv[++i] || (motion_params.frame_budget = atof(argv[i])) < 0.0) {
+					fprintf(stderr, "-B must be followed by a motion analysis budget in msec (0: off)\n");
+					return -1;
+				}
+				break;
+
+			case 'e':
+				if(!argv[++i]) {
+					fprintf(stderr, "-e must be followed by a motion engine\n");
+					return -1;
+				}
+				if(strcmp(argv[i], "all") == 0) {
+					all_engines = true;
+				} else if(is_motion_engine(argv[i])) {
+					motion_params.engine = argv[i];
+				} else {
+					fprintf(stderr, "invalid motion engine: %s\n", argv[i]);
+					return -1;
+				}
+				break;
+
+			case 'h':
+				printf("usage: %s [options]\n", argv[0]);
+				printf("options:\n");
+				printf(" -s <source>  synth (default), a recording (*.vkrec), or a video file /\n");
+				printf("              image sequence pattern\n");
+				printf(" -n <frames>  number of synthetic frames (default 300)\n");
+				printf(" -r           pace the source in real time instead of as fast as possible\n");
+				printf(" -e <engine>  motion engine: lk, farneback, block, mhi (default %s), or all\n",
+						motion_params.engine);
+				printf("              to run the suite with every engine\n");
+				printf(" -l <levels>  optical flow pyramid levels (default %d)\n", motion_params.pyr_levels);
+				printf(" -w <size>    optical flow window size (default %d)\n", motion_params.win_size);
+				printf(" -d <scale>   run motion analysis downscaled by this factor\n");
+				printf(" -R x,y,w,h   motion analysis region, in [0, 1] frame coordinates\n");
+				printf(" -D           measure cost and accuracy for a range of -d scales\n");
+				printf(" -J           measure the tiled lk engine with 1 thread up to one per CPU\n");
+				printf(" -S           run the synthetic sequence suite\n");
+				printf(" -o <file>    save the suite results as a baseline\n");
+				printf(" -b <file>    compare the suite results against a baseline, fail on regressions\n");
+				printf(" -P <policy>  frame drop policy when falling behind: none, stale (default none)\n");
+				printf(" -G           run motion analysis on static frames too\n");
+				printf(" -H           restrict motion analysis to the moving hand\n");
+				printf(" -T <n>       split lk detection and tracking into n x n tiles\n");
+				printf(" -j <threads> threads for the tiles (default: one per CPU)\n");
+				printf(" -B <msec>    adapt quality to this motion analysis budget per frame (default off)\n");
+				printf(" -h           print usage and exit\n");
+				exit(0);
+
+			default:
+				fprintf(stderr, "invalid option: %s\n", argv[i]);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+			return -1;
+		}
+	}
+
+	if((baseline_in || baseline_out) && !run_suite) {
+		fprintf(stderr, "-o and -b only apply to the sequence suite (-S)\n");
+		return -1;
+	}
+	if(all_engines && (!run_suite || baseline_in || baseline_out)) {
+		fprintf(stderr, "-e all only applies to the sequence suite (-S), without -o or -b\n");
+		return -1;
+	}
+	return 0;
+}
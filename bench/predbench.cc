@@ -0,0 +1,172 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* predbench - measures what word completion saves on a text corpus. The
+ * corpus is typed the way the keyboard would: one selection per letter or
+ * space, unless the word being typed is among the offered completions, in
+ * which case selecting it types the rest of the word and the space. Reports
+ * the characters typed per selection and the cost of a completion lookup.
+ * Only letters and word breaks of the corpus count, like on the strip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include "dict.h"
+#include "timer.h"
+
+static const char *words_file = "data/words.txt";
+static const char *corpus_file = "data/corpus.txt";
+static int num_completions = 3;
+
+static int parse_args(int argc, char **argv);
+static bool read_corpus(const char *fname, std::vector<std::string> *words);
+
+int main(int argc, char **argv)
+{
+	Dictionary dict;
+	std::vector<std::string> words, comp;
+
+	if(parse_args(argc, argv) == -1) {
+		return 1;
+	}
+	if(!dict.open(words_file) || !read_corpus(corpus_file, &words)) {
+		return 1;
+	}
+
+	unsigned long chars = 0, sel = 0, completed = 0, lookups = 0, lookup_usec = 0;
+
+	for(size_t i=0; i<words.size(); i++) {
+		const std::string &w = words[i];
+		std::string prefix;
+		bool done = false;
+
+		chars += w.size() + 1;	/* and the space */
+
+		while(!done && prefix.size() < w.size()) {
+			prefix += w[prefix.size()];
+			sel++;
+
+			uint64_t t0 = get_usec();
+			dict.complete(prefix.c_str(), num_completions, &comp);
+			lookup_usec += get_usec() - t0;
+			lookups++;
+
+			for(size_t j=0; j<comp.size(); j++) {
+				if(comp[j] == w) {
+					done = true;
+					break;
+				}
+			}
+		}
+		if(done) {
+			completed++;
+		}
+		sel++;	/* the completion, or the space */
+	}
+
+	printf("dictionary: %d words, corpus: %lu words, %lu characters\n", dict.num_words(),
+			(unsigned long)words.size(), chars);
+	printf("selections: %lu, %.3f characters per selection (1.0 without completion)\n",
+			sel, (double)chars / sel);
+	printf("completed words: %lu (%.1f%%), with %d completions offered\n", completed,
+			100.0 * completed / words.size(), num_completions);
+	printf("lookups: %lu, %.3f us/lookup\n", lookups, (double)lookup_usec / lookups);
+	return 0;
+}
+
+static bool read_corpus(const char *fname, std::vector<std::string> *words)
+{
+	FILE *fp;
+	std::string word;
+	int c;
+
+	if(!(fp = fopen(fname, "r"))) {
+		perror(fname);
+		return false;
+	}
+	while((c = fgetc(fp)) != EOF) {
+		if(isalpha(c)) {
+			word += tolower(c);
+		} else if(!word.empty()) {
+			words->push_back(word);
+			word.clear();
+		}
+	}
+	if(!word.empty()) {
+		words->push_back(word);
+	}
+	fclose(fp);
+
+	if(words->empty()) {
+		fprintf(stderr, "corpus %s has no words\n", fname);
+		return false;
+	}
+	return true;
+}
+
+static int parse_args(int argc, char **argv)
+{
+	for(int i=1; i<argc; i++) {
+		if(argv[i][0] == '-' && argv[i][2] == 0) {
+			switch(argv[i][1]) {
+			case 'D':
+				if(!argv[++i]) {
+					fprintf(stderr, "-D must be followed by a word list\n");
+					return -1;
+				}
+				words_file = argv[i];
+				break;
+
+			case 'c':
+				if(!argv[++i]) {
+					fprintf(stderr, "-c must be followed by a text corpus\n");
+					return -1;
+				}
+				corpus_file = argv[i];
+				break;
+
+			case 'k':
+				if(!argv[++i] || (num_completions = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-k must be followed by the number of completions\n");
+					return -1;
+				}
+				break;
+
+			case 'h':
+				printf("usage: %s [options]\n", argv[0]);
+				printf("options:\n");
+				printf(" -D <file>    word list (default %s)\n", words_file);
+				printf(" -c <file>    text corpus to type (default %s)\n", corpus_file);
+				printf(" -k <n>       completions offered (default %d)\n", num_completions);
+				printf(" -h           print usage and exit\n");
+				exit(0);
+
+			default:
+				fprintf(stderr, "invalid option: %s\n", argv[i]);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
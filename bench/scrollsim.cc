@@ -0,0 +1,211 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* scrollsim - replays a text corpus on the keyboard strip and counts the
+ * scroll steps it takes, from the selected glyph to the next one along the
+ * shorter way around the ring. It compares the static layout order against
+ * the bigram prediction mode (vkeyb -p), where the likeliest next glyphs are
+ * duplicated next to the selected one after each selection. The model learns
+ * from the corpus as it is typed, or starts out trained on a separate text.
+ * Only letters and word breaks of the corpus count, like on the strip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <X11/keysym.h>
+#include "atlas.h"
+#include "ring.h"
+#include "bigram.h"
+
+struct SimResult {
+	unsigned long chars, steps, near;	/* near: chars at most 2 steps away */
+	int max_steps;
+};
+
+static const char *layout_file = "data/layout.txt";
+static const char *corpus_file = "data/corpus.txt";
+static const char *train_file;
+static int num_predictions = 4;
+
+static int parse_args(int argc, char **argv);
+static void simulate(int num_glyphs, const std::vector<int> &text, const BigramModel *model,
+		int k, SimResult *res);
+static void print_result(const char *name, const SimResult &res);
+
+int main(int argc, char **argv)
+{
+	std::vector<LayoutKey> keys;
+	std::vector<int> text, train;
+	uint64_t hash;
+	int char_map[256];
+
+	if(parse_args(argc, argv) == -1) {
+		return 1;
+	}
+	if(!load_layout(layout_file, "", &keys, &hash)) {
+		return 1;
+	}
+	int num_glyphs = keys.size();
+
+	for(int i=0; i<256; i++) {
+		char_map[i] = -1;
+	}
+	for(int i=0; i<num_glyphs; i++) {
+		KeySym sym = keys[i].sym;
+		if(sym >= XK_a && sym <= XK_z) {
+			char_map['a' + sym - XK_a] = i;
+		} else if(sym == XK_space) {
+			char_map[' '] = i;
+		}
+	}
+
+	if(!read_text(corpus_file, char_map, &text)) {
+		return 1;
+	}
+	if(text.empty()) {
+		fprintf(stderr, "corpus %s has nothing to type on layout %s\n", corpus_file, layout_file);
+		return 1;
+	}
+
+	BigramModel model;
+	model.init(num_glyphs);
+	if(train_file) {
+		if(!read_text(train_file, char_map, &train)) {
+			return 1;
+		}
+		model.train(train);
+	}
+
+	SimResult stat, adapt;
+	simulate(num_glyphs, text, 0, 0, &stat);
+	simulate(num_glyphs, text, &model, num_predictions, &adapt);
+
+	printf("layout: %d glyphs, corpus: %lu characters\n", num_glyphs, stat.chars);
+	printf("adaptive: %d predicted glyphs, model %s\n", num_predictions,
+			train_file ? "pre-trained" : "learning online");
+	print_result("static", stat);
+	print_result("adaptive", adapt);
+	printf("%.1f%% fewer steps\n", 100.0 * (1.0 - (double)adapt.steps / stat.steps));
+	return 0;
+}
+
+/* model is copied, so that both runs start from the same state. With no
+ * model the ring stays in layout order.
+ */
+static void simulate(int num_glyphs, const std::vector<int> &text, const BigramModel *model,
+		int k, SimResult *res)
+{
+	SlotRing ring;
+	BigramModel bigrams;
+	std::vector<int> preds;
+	int active = 0, prev = -1;
+
+	ring.init(num_glyphs);
+	if(model) {
+		bigrams = *model;
+	}
+
+	res->chars = res->steps = res->near = 0;
+	res->max_steps = 0;
+
+	for(size_t i=0; i<text.size(); i++) {
+		int glyph = text[i];
+		int d = ring.distance(active, glyph);
+
+		active = (active + d + ring.size()) % ring.size();
+		d = abs(d);
+
+		res->chars++;
+		res->steps += d;
+		if(d <= 2) res->near++;
+		if(d > res->max_steps) res->max_steps = d;
+
+		if(model) {
+			bigrams.add(prev, glyph);
+			bigrams.predict(glyph, k, &preds);
+			active = ring.set_predictions(active, preds);
+		}
+		prev = glyph;
+	}
+}
+
+static void print_result(const char *name, const SimResult &res)
+{
+	printf("  %-9s %.3f steps/char, %.1f%% within 2 steps, at most %d\n", name,
+			(double)res.steps / res.chars, 100.0 * res.near / res.chars, res.max_steps);
+}
+
+static int parse_args(int argc, char **argv)
+{
+	for(int i=1; i<argc; i++) {
+		if(argv[i][0] == '-' && argv[i][2] == 0) {
+			switch(argv[i][1]) {
+			case 'L':
+				if(!argv[++i]) {
+					fprintf(stderr, "-L must be followed by a layout file\n");
+					return -1;
+				}
+				layout_file = argv[i];
+				break;
+
+			case 'c':
+				if(!argv[++i]) {
+					fprintf(stderr, "-c must be followed by a text corpus\n");
+					return -1;
+				}
+				corpus_file = argv[i];
+				break;
+
+			case 't':
+				if(!argv[++i]) {
+					fprintf(stderr, "-t must be followed by a text to train the model on\n");
+					return -1;
+				}
+				train_file = argv[i];
+				break;
+
+			case 'p':
+				if(!argv[++i] || (num_predictions = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-p must be followed by the number of predicted glyphs\n");
+					return -1;
+				}
+				break;
+
+			case 'h':
+				printf("usage: %s [options]\n", argv[0]);
+				printf("options:\n");
+				printf(" -L <file>    keyboard layout (default %s)\n", layout_file);
+				printf(" -c <file>    text corpus to type (default %s)\n", corpus_file);
+				printf(" -t <file>    train the model on this text first (default: learn online)\n");
+				printf(" -p <n>       predicted glyphs next to the selected one (default %d)\n",
+						num_predictions);
+				printf(" -h           print usage and exit\n");
+				exit(0);
+
+			default:
+				fprintf(stderr, "invalid option: %s\n", argv[i]);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
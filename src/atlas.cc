@@ -0,0 +1,376 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <X11/Xutil.h>
+#include "atlas.h"
+#include "hash.h"
+
+#define CELL_PAD		4		/* pixels around the widest label */
+#define BG_COLOR		0x20
+#define SEP_COLOR		0x60	/* cell separator on the left edge */
+
+static int utf8_to_ucs2(const char *str, XChar2b *buf, int max);
+static void downsample(const unsigned char *src, int sw, int sh, unsigned char *dest, int dw, int dh);
+
+bool load_layout(const char *fname, const char *font, std::vector<LayoutKey> *keys,
+		uint64_t *hash)
+{
+	FILE *fp;
+	char buf[256];
+	int version = ATLAS_VERSION;
+	int line = 0;
+
+	if(!(fp = fopen(fname, "r"))) {
+		fprintf(stderr, "failed to open layout %s: %s\n", fname, strerror(errno));
+		return false;
+	}
+
+	*hash = hash_bytes(HASH_INIT, &version, sizeof version);
+	*hash = hash_bytes(*hash, font, strlen(font) + 1);
+	keys->clear();
+
+	while(fgets(buf, sizeof buf, fp)) {
+		line++;
+		*hash = hash_bytes(*hash, buf, strlen(buf));
+
+		char *name = buf;
+		while(*name && isspace(*name)) name++;
+		if(!*name || *name == '#') {
+			continue;
+		}
+
+		char *label = name;
+		while(*label && !isspace(*label)) label++;
+		if(*label) {
+			*label++ = 0;
+		}
+		while(*label && isspace(*label)) label++;
+		char *end = label + strlen(label);
+		while(end > label && isspace(end[-1])) *--end = 0;
+
+		LayoutKey key;
+		if((key.sym = XStringToKeysym(name)) == NoSymbol) {
+			fprintf(stderr, "%s:%d: unknown keysym: %s\n", fname, line, name);
+			fclose(fp);
+			return false;
+		}
+		if(!*label) {
+			fprintf(stderr, "%s:%d: missing label of %s\n", fname, line, name);
+			fclose(fp);
+			return false;
+		}
+		key.label = label;
+		keys->push_back(key);
+	}
+	fclose(fp);
+
+	if(keys->empty()) {
+		fprintf(stderr, "layout %s has no keys\n", fname);
+		return false;
+	}
+	return true;
+}
+
+bool build_atlas(Display *dpy, const char *font_name, const std::vector<LayoutKey> &keys,
+		uint64_t hash, std::vector<unsigned char> *buf)
+{
+	XFontStruct *font;
+	int num_keys = keys.size();
+	std::vector<XChar2b> text(num_keys * 16);
+	std::vector<int> text_len(num_keys);
+
+	if(!(font = XLoadQueryFont(dpy, font_name))) {
+		fprintf(stderr, "failed to load font: %s\n", font_name);
+		return false;
+	}
+
+	/* the cells fit the widest label */
+	int cell_w = 0;
+	for(int i=0; i<num_keys; i++) {
+		XCharStruct cs;
+		int dir, asc, desc;
+
+		text_len[i] = utf8_to_ucs2(keys[i].label.c_str(), &text[i * 16], 16);
+		XTextExtents16(font, &text[i * 16], text_len[i], &dir, &asc, &desc, &cs);
+		if(cs.width > cell_w) {
+			cell_w = cs.width;
+		}
+	}
+	cell_w += CELL_PAD * 2;
+	int cell_h = font->ascent + font->descent + CELL_PAD * 2;
+	int width = cell_w * num_keys;
+	int height = cell_h;
+
+	Window root = DefaultRootWindow(dpy);
+	int scr = DefaultScreen(dpy);
+	Pixmap pix = XCreatePixmap(dpy, root, width, height, DefaultDepth(dpy, scr));
+
+	XGCValues gcv;
+	gcv.font = font->fid;
+	gcv.foreground = BlackPixel(dpy, scr);
+	GC gc = XCreateGC(dpy, pix, GCFont | GCForeground, &gcv);
+	XFillRectangle(dpy, pix, gc, 0, 0, width, height);
+	XSetForeground(dpy, gc, WhitePixel(dpy, scr));
+
+	for(int i=0; i<num_keys; i++) {
+		int tw = XTextWidth16(font, &text[i * 16], text_len[i]);
+		int x = i * cell_w + (cell_w - tw) / 2;
+		XDrawString16(dpy, pix, gc, x, CELL_PAD + font->ascent, &text[i * 16], text_len[i]);
+	}
+
+	XImage *img = XGetImage(dpy, pix, 0, 0, width, height, AllPlanes, ZPixmap);
+	XFreeGC(dpy, gc);
+	XFreePixmap(dpy, pix);
+	XFreeFont(dpy, font);
+	if(!img) {
+		fprintf(stderr, "failed to read back the glyph atlas\n");
+		return false;
+	}
+
+	/* lay out the file: header, keysyms, then every level down to 1x1 */
+	AtlasHeader hdr;
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.magic, ATLAS_MAGIC, sizeof hdr.magic);
+	hdr.version = ATLAS_VERSION;
+	hdr.num_glyphs = num_keys;
+	hdr.hash = hash;
+	hdr.cell_width = cell_w;
+	hdr.cell_height = cell_h;
+	hdr.keysym_offset = sizeof hdr;
+
+	size_t size = (hdr.keysym_offset + num_keys * sizeof(uint32_t) + 15) & ~(size_t)15;
+	int lw = width, lh = height;
+	for(;;) {
+		AtlasLevel *lvl = hdr.level + hdr.num_levels++;
+		lvl->offset = size;
+		lvl->width = lw;
+		lvl->height = lh;
+		size += (lw * lh * 4 + 15) & ~15;
+
+		if((lw == 1 && lh == 1) || hdr.num_levels >= ATLAS_MAX_LEVELS) {
+			break;
+		}
+		lw = lw > 1 ? lw / 2 : 1;
+		lh = lh > 1 ? lh / 2 : 1;
+	}
+
+	buf->assign(size, 0);
+	memcpy(&(*buf)[0], &hdr, sizeof hdr);
+	uint32_t *syms = (uint32_t*)&(*buf)[hdr.keysym_offset];
+	for(int i=0; i<num_keys; i++) {
+		syms[i] = keys[i].sym;
+	}
+
+	/* white labels on an opaque background */
+	unsigned long black = BlackPixel(dpy, scr);
+	unsigned char *pixels = &(*buf)[hdr.level[0].offset];
+	for(int i=0; i<height; i++) {
+		for(int j=0; j<width; j++) {
+			unsigned char *p = pixels + (i * width + j) * 4;
+			int val = XGetPixel(img, j, i) != black ? 255 : (j % cell_w == 0 ? SEP_COLOR : BG_COLOR);
+			p[0] = p[1] = p[2] = val;
+			p[3] = 255;
+		}
+	}
+	XDestroyImage(img);
+
+	for(unsigned int i=1; i<hdr.num_levels; i++) {
+		const AtlasLevel *src = hdr.level + i - 1;
+		const AtlasLevel *dest = hdr.level + i;
+		downsample(&(*buf)[src->offset], src->width, src->height, &(*buf)[dest->offset],
+				dest->width, dest->height);
+	}
+	return true;
+}
+
+AtlasFile::AtlasFile()
+{
+	data = 0;
+	size = 0;
+	mapped = false;
+	hdr = 0;
+}
+
+AtlasFile::~AtlasFile()
+{
+	close();
+}
+
+bool AtlasFile::open(const char *fname, uint64_t hash)
+{
+	struct stat st;
+	int fd;
+
+	close();
+
+	if((fd = ::open(fname, O_RDONLY)) == -1) {
+		if(errno != ENOENT) {
+			fprintf(stderr, "failed to open glyph atlas %s: %s\n", fname, strerror(errno));
+		}
+		return false;
+	}
+	if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(AtlasHeader)) {
+		fprintf(stderr, "%s is not a glyph atlas\n", fname);
+		::close(fd);
+		return false;
+	}
+
+	size = st.st_size;
+	data = (unsigned char*)mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED) {
+		fprintf(stderr, "failed to map glyph atlas %s: %s\n", fname, strerror(errno));
+		data = 0;
+		return false;
+	}
+
+	mapped = true;
+	return validate(fname, hash);
+}
+
+bool AtlasFile::open(std::vector<unsigned char> *buf, uint64_t hash)
+{
+	close();
+
+	mem.swap(*buf);
+	data = mem.empty() ? 0 : &mem[0];
+	size = mem.size();
+	if(size < sizeof(AtlasHeader)) {
+		close();
+		return false;
+	}
+	return validate("in-memory", hash);
+}
+
+/* checks the header and that everything it points to is in the data */
+bool AtlasFile::validate(const char *name, uint64_t hash)
+{
+	hdr = (const AtlasHeader*)data;
+	if(memcmp(hdr->magic, ATLAS_MAGIC, sizeof hdr->magic) != 0 || hdr->version != ATLAS_VERSION) {
+		fprintf(stderr, "%s is not a glyph atlas, or of an unsupported version\n", name);
+		close();
+		return false;
+	}
+	if(hdr->hash != hash) {
+		close();
+		return false;
+	}
+
+	bool valid = hdr->num_levels > 0 && hdr->num_levels <= ATLAS_MAX_LEVELS &&
+		hdr->keysym_offset + (size_t)hdr->num_glyphs * sizeof(uint32_t) <= size;
+	for(unsigned int i=0; valid && i<hdr->num_levels; i++) {
+		const AtlasLevel *lvl = hdr->level + i;
+		valid = lvl->offset + (size_t)lvl->width * lvl->height * 4 <= size;
+	}
+	if(!valid) {
+		fprintf(stderr, "glyph atlas %s is damaged\n", name);
+		close();
+		return false;
+	}
+	return true;
+}
+
+void AtlasFile::close()
+{
+	if(data && mapped) {
+		munmap(data, size);
+	}
+	data = 0;
+	mapped = false;
+	mem.clear();
+	size = 0;
+	hdr = 0;
+}
+
+int AtlasFile::num_glyphs() const
+{
+	return hdr ? hdr->num_glyphs : 0;
+}
+
+int AtlasFile::num_levels() const
+{
+	return hdr ? hdr->num_levels : 0;
+}
+
+KeySym AtlasFile::keysym(int idx) const
+{
+	return ((const uint32_t*)(data + hdr->keysym_offset))[idx];
+}
+
+const unsigned char *AtlasFile::level(int lvl, int *width, int *height) const
+{
+	*width = hdr->level[lvl].width;
+	*height = hdr->level[lvl].height;
+	return data + hdr->level[lvl].offset;
+}
+
+/* decodes up to max characters of the basic multilingual plane */
+static int utf8_to_ucs2(const char *str, XChar2b *buf, int max)
+{
+	const unsigned char *ptr = (const unsigned char*)str;
+	int len = 0;
+
+	while(*ptr && len < max) {
+		unsigned int c = *ptr++;
+
+		if(c >= 0xe0) {
+			c = (c & 0x0f) << 12;
+			if(*ptr) c |= (*ptr++ & 0x3f) << 6;
+			if(*ptr) c |= *ptr++ & 0x3f;
+		} else if(c >= 0xc0) {
+			c = (c & 0x1f) << 6;
+			if(*ptr) c |= *ptr++ & 0x3f;
+		}
+		buf[len].byte1 = c >> 8;
+		buf[len].byte2 = c & 0xff;
+		len++;
+	}
+	return len;
+}
+
+/* box filters the next mipmap level, odd sizes drop their last row or
+ * column
+ */
+static void downsample(const unsigned char *src, int sw, int sh, unsigned char *dest, int dw, int dh)
+{
+	for(int i=0; i<dh; i++) {
+		int y0 = std::min(i * 2, sh - 1), y1 = std::min(i * 2 + 1, sh - 1);
+
+		for(int j=0; j<dw; j++) {
+			int x0 = std::min(j * 2, sw - 1), x1 = std::min(j * 2 + 1, sw - 1);
+			const unsigned char *p00 = src + (y0 * sw + x0) * 4;
+			const unsigned char *p01 = src + (y0 * sw + x1) * 4;
+			const unsigned char *p10 = src + (y1 * sw + x0) * 4;
+			const unsigned char *p11 = src + (y1 * sw + x1) * 4;
+
+			for(int k=0; k<4; k++) {
+				*dest++ = (p00[k] + p01[k] + p10[k] + p11[k] + 2) / 4;
+			}
+		}
+	}
+}
@@ -0,0 +1,102 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ATLAS_H_
+#define ATLAS_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <X11/Xlib.h>
+
+/* Glyph atlas of the keyboard strip. The glyphs are laid out left to right in
+ * equal cells of a single row, in layout order, so that the strip can scroll
+ * by offsetting the texture coordinates and wrap around. The atlas is built
+ * from a layout file, rasterized with an X core font, and cached (see
+ * cache.h) in a binary file holding the RGBA pixels of the whole mipmap
+ * chain, which later runs map and upload as they are. The cache is keyed by a
+ * hash of the layout, the font and the atlas format, so any change to them
+ * triggers a rebuild. Without a usable cache the atlas is kept in memory.
+ * Integers are stored in host byte order.
+ */
+#define ATLAS_MAGIC			"VKBATL1"
+#define ATLAS_VERSION		1
+#define ATLAS_MAX_LEVELS	16
+
+struct AtlasLevel {
+	uint32_t offset;		/* of the pixels from the start of the file */
+	uint32_t width, height;	/* rows are packed, 4 bytes per pixel */
+};
+
+struct AtlasHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_glyphs;
+	uint64_t hash;			/* of the layout and font the atlas was built from */
+	uint32_t cell_width, cell_height;	/* at level 0 */
+	uint32_t keysym_offset;	/* num_glyphs uint32 keysyms, in layout order */
+	uint32_t num_levels;
+	AtlasLevel level[ATLAS_MAX_LEVELS];
+};
+
+/* a key of the layout: its keysym and the label drawn on its glyph */
+struct LayoutKey {
+	KeySym sym;
+	std::string label;		/* UTF-8 */
+};
+
+/* Reads a layout file: one key per line, a keysym name (see XStringToKeysym)
+ * followed by the label, blank lines and lines starting with # are ignored.
+ * hash is computed over the contents, the font name and the atlas format.
+ */
+bool load_layout(const char *fname, const char *font, std::vector<LayoutKey> *keys,
+		uint64_t *hash);
+
+/* rasterizes the labels with the X core font, into the atlas file image buf */
+bool build_atlas(Display *dpy, const char *font, const std::vector<LayoutKey> &keys,
+		uint64_t hash, std::vector<unsigned char> *buf);
+
+/* memory mapped atlas file, or an atlas built in memory */
+class AtlasFile {
+private:
+	unsigned char *data;
+	size_t size;
+	bool mapped;
+	std::vector<unsigned char> mem;
+	const AtlasHeader *hdr;
+
+	bool validate(const char *name, uint64_t hash);
+
+public:
+	AtlasFile();
+	~AtlasFile();
+
+	/* fails if the file is missing, damaged or doesn't match hash */
+	bool open(const char *fname, uint64_t hash);
+	/* takes over an atlas built with build_atlas, leaving buf empty */
+	bool open(std::vector<unsigned char> *buf, uint64_t hash);
+	void close();
+
+	int num_glyphs() const;
+	int num_levels() const;
+	KeySym keysym(int idx) const;
+	/* RGBA pixels of a mipmap level, in place in the mapping */
+	const unsigned char *level(int lvl, int *width, int *height) const;
+};
+
+#endif	/* ATLAS_H_ */
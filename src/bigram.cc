@@ -0,0 +1,109 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <ctype.h>
+#include "bigram.h"
+
+BigramModel::BigramModel()
+{
+	num_syms = 0;
+}
+
+void BigramModel::init(int num_syms)
+{
+	this->num_syms = num_syms;
+	counts.assign(num_syms * num_syms, 0);
+	totals.assign(num_syms, 0);
+}
+
+void BigramModel::add(int prev, int next)
+{
+	if(prev < 0 || prev >= num_syms || next < 0 || next >= num_syms) {
+		return;
+	}
+	counts[prev * num_syms + next]++;
+	totals[next]++;
+}
+
+void BigramModel::train(const std::vector<int> &seq)
+{
+	for(size_t i=1; i<seq.size(); i++) {
+		add(seq[i - 1], seq[i]);
+	}
+}
+
+int BigramModel::predict(int prev, int k, std::vector<int> *res) const
+{
+	res->clear();
+	if(prev < 0 || prev >= num_syms) {
+		return 0;
+	}
+	const unsigned int *row = &counts[prev * num_syms];
+
+	/* partial selection sort, k is a handful */
+	for(int n=0; n<k; n++) {
+		int best = -1;
+		for(int i=0; i<num_syms; i++) {
+			if(!row[i] && !totals[i]) continue;
+
+			bool taken = false;
+			for(size_t j=0; j<res->size(); j++) {
+				if((*res)[j] == i) taken = true;
+			}
+			if(taken) continue;
+
+			if(best == -1 || row[i] > row[best] || (row[i] == row[best] && totals[i] > totals[best])) {
+				best = i;
+			}
+		}
+		if(best == -1) {
+			break;
+		}
+		res->push_back(best);
+	}
+	return res->size();
+}
+
+bool read_text(const char *fname, const int *char_map, std::vector<int> *seq)
+{
+	FILE *fp;
+	int c;
+	bool brk = false;
+
+	if(!(fp = fopen(fname, "r"))) {
+		perror(fname);
+		return false;
+	}
+	seq->clear();
+	while((c = fgetc(fp)) != EOF) {
+		if(isalpha(c)) {
+			if(brk && char_map[' '] >= 0) {
+				seq->push_back(char_map[' ']);
+			}
+			brk = false;
+			if(char_map[tolower(c)] >= 0) {
+				seq->push_back(char_map[tolower(c)]);
+			}
+		} else if(!seq->empty()) {
+			brk = true;
+		}
+	}
+	fclose(fp);
+	return true;
+}
@@ -0,0 +1,54 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BIGRAM_H_
+#define BIGRAM_H_
+
+#include <vector>
+
+/* Character bigram model over the glyphs of the keyboard: counts how often
+ * each glyph followed each other one, and predicts the likeliest next glyphs.
+ * Glyphs never seen after the previous one fall back to overall frequency.
+ */
+class BigramModel {
+private:
+	int num_syms;
+	std::vector<unsigned int> counts;	/* previous glyph major */
+	std::vector<unsigned int> totals;	/* how often each glyph followed anything */
+
+public:
+	BigramModel();
+
+	void init(int num_syms);
+
+	void add(int prev, int next);
+	void train(const std::vector<int> &seq);
+
+	/* the k likeliest glyphs to follow prev, likeliest first, prev itself
+	 * included. Returns their number.
+	 */
+	int predict(int prev, int k, std::vector<int> *res) const;
+};
+
+/* Reads a text as a glyph sequence. char_map maps the lowercase letters to
+ * their glyphs (or -1), and any run of other characters becomes the glyph
+ * of ' ', if it has one.
+ */
+bool read_text(const char *fname, const int *char_map, std::vector<int> *seq);
+
+#endif	/* BIGRAM_H_ */
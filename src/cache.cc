@@ -0,0 +1,103 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+static bool make_dir(const std::string &dir);
+
+bool cache_path(const char *kind, uint64_t hash, std::string *path)
+{
+	const char *env;
+	std::string dir;
+
+	if((env = getenv("XDG_CACHE_HOME")) && *env) {
+		dir = env;
+	} else if((env = getenv("HOME")) && *env) {
+		dir = std::string(env) + "/.cache";
+	} else {
+		return false;
+	}
+	dir += "/vkeyb";
+
+	if(!make_dir(dir)) {
+		return false;
+	}
+
+	char name[64];
+	snprintf(name, sizeof name, "/%s-%016llx.cache", kind, (unsigned long long)hash);
+	*path = dir + name;
+	return true;
+}
+
+bool write_cache(const char *fname, const void *data, size_t size)
+{
+	/* a unique temporary, so that concurrent writers of the same cache never
+	 * share an inode, and the last rename wins with a complete file
+	 */
+	std::string tmpname = std::string(fname) + ".XXXXXX";
+	int fd = mkstemp(&tmpname[0]);
+	if(fd == -1) {
+		fprintf(stderr, "failed to create %s: %s\n", tmpname.c_str(), strerror(errno));
+		return false;
+	}
+	fchmod(fd, 0644);
+
+	const char *ptr = (const char*)data;
+	while(size > 0) {
+		ssize_t wr = write(fd, ptr, size);
+		if(wr == -1) {
+			if(errno == EINTR) continue;
+			fprintf(stderr, "failed to write %s: %s\n", tmpname.c_str(), strerror(errno));
+			close(fd);
+			unlink(tmpname.c_str());
+			return false;
+		}
+		ptr += wr;
+		size -= wr;
+	}
+	close(fd);
+
+	if(rename(tmpname.c_str(), fname) == -1) {
+		fprintf(stderr, "failed to rename %s to %s: %s\n", tmpname.c_str(), fname, strerror(errno));
+		unlink(tmpname.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* creates dir and its parents, like mkdir -p */
+static bool make_dir(const std::string &dir)
+{
+	for(size_t pos = 1; pos != std::string::npos; ) {
+		pos = dir.find('/', pos + 1);
+		std::string sub = dir.substr(0, pos);
+
+		if(mkdir(sub.c_str(), 0755) == -1 && errno != EEXIST) {
+			fprintf(stderr, "failed to create cache directory %s: %s\n", sub.c_str(), strerror(errno));
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,43 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/* Cache files of data derived from the layout and the word list live in
+ * $XDG_CACHE_HOME/vkeyb, or ~/.cache/vkeyb without it. They are named after
+ * their kind and the hash of their source, so stale ones are never picked up.
+ * The cache is optional: callers fall back to building the data in memory
+ * when there is no usable cache directory or it can't be written.
+ */
+
+/* the cache file of kind (e.g. "atlas") for hash. Creates the cache
+ * directory if needed, returns false if there is none to be had.
+ */
+bool cache_path(const char *kind, uint64_t hash, std::string *path);
+
+/* writes data to fname under a temporary name and renames it into place, so
+ * other runs never map a partial file
+ */
+bool write_cache(const char *fname, const void *data, size_t size);
+
+#endif	/* CACHE_H_ */
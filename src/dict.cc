@@ -0,0 +1,388 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "dict.h"
+#include "hash.h"
+#include "cache.h"
+
+#define MAX_WORD_LEN	64
+
+/* trie node while building */
+struct BuildNode {
+	char ch;
+	uint32_t weight, best;
+	std::vector<int> children;	/* sorted by character */
+};
+
+static bool read_file(const char *fname, std::string *buf);
+static int add_child(std::vector<BuildNode> &trie, int node, char ch);
+static uint32_t update_best(std::vector<BuildNode> &trie, int node);
+
+Dictionary::Dictionary()
+{
+	data = 0;
+	size = 0;
+	mapped = false;
+	hdr = 0;
+	nodes = 0;
+}
+
+Dictionary::~Dictionary()
+{
+	close();
+}
+
+bool Dictionary::open(const char *words_fname)
+{
+	std::string words, fname;
+	std::vector<unsigned char> buf;
+	int version = DICT_VERSION;
+
+	close();
+
+	if(!read_file(words_fname, &words)) {
+		return false;
+	}
+	uint64_t hash = hash_bytes(HASH_INIT, &version, sizeof version);
+	hash = hash_bytes(hash, words.data(), words.size());
+	bool cached = cache_path("dict", hash, &fname);
+
+	if(cached && map(fname.c_str(), hash)) {
+		return true;
+	}
+	printf("building dictionary of %s\n", words_fname);
+	if(!build_dict(words_fname, hash, &buf)) {
+		return false;
+	}
+	if(cached && write_cache(fname.c_str(), &buf[0], buf.size()) && map(fname.c_str(), hash)) {
+		return true;
+	}
+
+	/* no cache, this run keeps the trie in memory */
+	fprintf(stderr, "dictionary not cached, keeping it in memory\n");
+	mem.swap(buf);
+	data = &mem[0];
+	size = mem.size();
+	return validate("in-memory", hash);
+}
+
+bool Dictionary::map(const char *fname, uint64_t hash)
+{
+	struct stat st;
+	int fd;
+
+	if((fd = ::open(fname, O_RDONLY)) == -1) {
+		if(errno != ENOENT) {
+			fprintf(stderr, "failed to open dictionary %s: %s\n", fname, strerror(errno));
+		}
+		return false;
+	}
+	if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(DictHeader)) {
+		fprintf(stderr, "%s is not a dictionary\n", fname);
+		::close(fd);
+		return false;
+	}
+
+	size = st.st_size;
+	data = (unsigned char*)mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED) {
+		fprintf(stderr, "failed to map dictionary %s: %s\n", fname, strerror(errno));
+		data = 0;
+		return false;
+	}
+	mapped = true;
+	return validate(fname, hash);
+}
+
+/* checks the header, and that every child range lies within the nodes and
+ * after its parent, so that walking the trie stays in bounds and ends
+ */
+bool Dictionary::validate(const char *name, uint64_t hash)
+{
+	hdr = (const DictHeader*)data;
+	if(memcmp(hdr->magic, DICT_MAGIC, sizeof hdr->magic) != 0 || hdr->version != DICT_VERSION) {
+		fprintf(stderr, "%s is not a dictionary, or of an unsupported version\n", name);
+		close();
+		return false;
+	}
+	if(hdr->hash != hash) {
+		close();
+		return false;
+	}
+
+	const TrieNode *tn = (const TrieNode*)(data + sizeof *hdr);
+	uint32_t num = hdr->num_nodes;
+	bool valid = num >= 1 && sizeof *hdr + (size_t)num * sizeof *tn <= size;
+
+	for(uint32_t i=0; valid && i<num; i++) {
+		uint32_t first = tn[i].children >> 8;
+		uint32_t count = tn[i].children & 0xff;
+		valid = !count || (first > i && first + count <= num);
+	}
+	if(!valid) {
+		fprintf(stderr, "dictionary %s is damaged\n", name);
+		close();
+		return false;
+	}
+	nodes = tn;
+	return true;
+}
+
+void Dictionary::close()
+{
+	if(data && mapped) {
+		munmap(data, size);
+	}
+	data = 0;
+	mapped = false;
+	mem.clear();
+	size = 0;
+	hdr = 0;
+	nodes = 0;
+}
+
+bool Dictionary::is_open() const
+{
+	return nodes != 0;
+}
+
+int Dictionary::num_words() const
+{
+	return hdr ? hdr->num_words : 0;
+}
+
+int Dictionary::find(const char *prefix) const
+{
+	int node = 0;
+
+	for(const char *p=prefix; *p; p++) {
+		int first = nodes[node].children >> 8;
+		int count = nodes[node].children & 0xff;
+
+		node = -1;
+		for(int i=first; i<first + count; i++) {
+			if((char)(nodes[i].best & 0xff) == *p) {
+				node = i;
+				break;
+			}
+		}
+		if(node == -1) {
+			return -1;
+		}
+	}
+	return node;
+}
+
+/* a subtree still to expand, or a word if node is -1 - the word's node */
+struct Candidate {
+	uint32_t score;
+	int node;
+	std::string str;
+
+	bool operator <(const Candidate &c) const { return score < c.score; }
+};
+
+int Dictionary::complete(const char *prefix, int k, std::vector<std::string> *res) const
+{
+	std::vector<Candidate> heap;
+	int node;
+
+	res->clear();
+	if(!nodes || k <= 0 || (node = find(prefix)) == -1) {
+		return 0;
+	}
+
+	Candidate cand;
+	cand.score = nodes[node].best >> 8;
+	cand.node = node;
+	cand.str = prefix;
+	heap.push_back(cand);
+
+	/* the subtree bound never underestimates, so words pop off the heap in
+	 * order of frequency
+	 */
+	while(!heap.empty() && (int)res->size() < k) {
+		std::pop_heap(heap.begin(), heap.end());
+		cand = heap.back();
+		heap.pop_back();
+
+		if(cand.node < 0) {
+			if(cand.str != prefix) {
+				res->push_back(cand.str);
+			}
+			continue;
+		}
+
+		const TrieNode *n = nodes + cand.node;
+		if(n->weight) {
+			Candidate word;
+			word.score = n->weight;
+			word.node = -1 - cand.node;
+			word.str = cand.str;
+			heap.push_back(word);
+			std::push_heap(heap.begin(), heap.end());
+		}
+
+		int first = n->children >> 8;
+		int count = n->children & 0xff;
+		for(int i=first; i<first + count; i++) {
+			Candidate child;
+			child.score = nodes[i].best >> 8;
+			child.node = i;
+			child.str = cand.str + (char)(nodes[i].best & 0xff);
+			heap.push_back(child);
+			std::push_heap(heap.begin(), heap.end());
+		}
+	}
+	return res->size();
+}
+
+bool build_dict(const char *words_fname, uint64_t hash, std::vector<unsigned char> *buf)
+{
+	std::string words;
+	std::vector<BuildNode> trie(1);
+	int num_words = 0;
+
+	if(!read_file(words_fname, &words)) {
+		return false;
+	}
+	trie[0].ch = 0;
+	trie[0].weight = trie[0].best = 0;
+
+	char *line = &words[0];
+	while(*line) {
+		char *end = strchr(line, '\n');
+		if(end) *end = 0;
+
+		char word[MAX_WORD_LEN];
+		unsigned long weight = 1;
+		/* words with anything but a-z can't be typed on the strip, they're
+		 * skipped before any of their prefix goes into the trie, and so are
+		 * words too long for the buffer, rather than their truncated prefix
+		 */
+		const char *tok = line + strspn(line, " \t");
+		if(strcspn(tok, " \t\r") < MAX_WORD_LEN &&
+				sscanf(tok, "%63s %lu", word, &weight) >= 1 && word[0] != '#' && weight &&
+				strspn(word, "abcdefghijklmnopqrstuvwxyz") == strlen(word)) {
+			int node = 0;
+			for(char *p=word; *p; p++) {
+				node = add_child(trie, node, *p);
+			}
+			if(!trie[node].weight) {
+				num_words++;
+			}
+			weight += trie[node].weight;
+			trie[node].weight = weight > DICT_MAX_WEIGHT ? DICT_MAX_WEIGHT : weight;
+		}
+
+		if(!end) break;
+		line = end + 1;
+	}
+	update_best(trie, 0);
+
+	/* breadth first order, so that siblings end up contiguous */
+	std::vector<int> order(1, 0), pos(trie.size());
+	for(size_t i=0; i<order.size(); i++) {
+		pos[order[i]] = i;
+		const std::vector<int> &kids = trie[order[i]].children;
+		order.insert(order.end(), kids.begin(), kids.end());
+	}
+
+	DictHeader hdr;
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.magic, DICT_MAGIC, sizeof hdr.magic);
+	hdr.version = DICT_VERSION;
+	hdr.num_nodes = order.size();
+	hdr.hash = hash;
+	hdr.num_words = num_words;
+
+	std::vector<TrieNode> nodes(order.size());
+	for(size_t i=0; i<order.size(); i++) {
+		const BuildNode &bn = trie[order[i]];
+		int first = bn.children.empty() ? 0 : pos[bn.children[0]];
+		nodes[i].children = (first << 8) | bn.children.size();
+		nodes[i].weight = bn.weight;
+		nodes[i].best = (bn.best << 8) | (unsigned char)bn.ch;
+	}
+
+	buf->resize(sizeof hdr + nodes.size() * sizeof nodes[0]);
+	memcpy(&(*buf)[0], &hdr, sizeof hdr);
+	memcpy(&(*buf)[sizeof hdr], &nodes[0], nodes.size() * sizeof nodes[0]);
+	return true;
+}
+
+static bool read_file(const char *fname, std::string *buf)
+{
+	FILE *fp;
+	char chunk[4096];
+	size_t sz;
+
+	if(!(fp = fopen(fname, "rb"))) {
+		fprintf(stderr, "failed to open %s: %s\n", fname, strerror(errno));
+		return false;
+	}
+	buf->clear();
+	while((sz = fread(chunk, 1, sizeof chunk, fp)) > 0) {
+		buf->append(chunk, sz);
+	}
+	fclose(fp);
+	return true;
+}
+
+static int add_child(std::vector<BuildNode> &trie, int node, char ch)
+{
+	std::vector<int> &kids = trie[node].children;
+	size_t i;
+
+	for(i=0; i<kids.size() && trie[kids[i]].ch < ch; i++);
+	if(i < kids.size() && trie[kids[i]].ch == ch) {
+		return kids[i];
+	}
+
+	BuildNode child;
+	child.ch = ch;
+	child.weight = child.best = 0;
+	trie.push_back(child);
+
+	/* trie may have moved, don't use kids from here on */
+	int idx = trie.size() - 1;
+	trie[node].children.insert(trie[node].children.begin() + i, idx);
+	return idx;
+}
+
+static uint32_t update_best(std::vector<BuildNode> &trie, int node)
+{
+	uint32_t best = trie[node].weight;
+
+	for(size_t i=0; i<trie[node].children.size(); i++) {
+		uint32_t b = update_best(trie, trie[node].children[i]);
+		if(b > best) best = b;
+	}
+	trie[node].best = best;
+	return best;
+}
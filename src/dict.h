@@ -0,0 +1,92 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DICT_H_
+#define DICT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Word completion dictionary. The words and their frequencies are compiled
+ * into a trie which is cached in a file (see cache.h) and used in place
+ * through a memory mapping, so loading it only takes a pass over the nodes
+ * to check their links. Without a usable cache the trie is kept in memory.
+ * The nodes are stored breadth first,
+ * the children of each node are contiguous and sorted by character, and every
+ * node carries the highest word frequency of its subtree, so the top-k
+ * completions of a prefix are found best first without visiting the rest of
+ * the subtree. Like the glyph atlas, the cache is keyed by a hash of the word
+ * list. Integers are stored in host byte order.
+ */
+#define DICT_MAGIC		"VKBDIC1"
+#define DICT_VERSION	1
+#define DICT_MAX_WEIGHT	0xffffff
+
+struct DictHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_nodes;		/* the root is node 0 */
+	uint64_t hash;			/* of the word list the trie was built from */
+	uint32_t num_words;
+	uint32_t pad;
+};
+
+struct TrieNode {
+	uint32_t children;		/* index of the first child << 8 | number of children */
+	uint32_t weight;		/* frequency of the word ending here, 0 if none */
+	uint32_t best;			/* highest weight in the subtree << 8 | character */
+};
+
+class Dictionary {
+private:
+	unsigned char *data;
+	size_t size;
+	bool mapped;
+	std::vector<unsigned char> mem;
+	const DictHeader *hdr;
+	const TrieNode *nodes;
+
+	bool map(const char *fname, uint64_t hash);
+	bool validate(const char *name, uint64_t hash);
+	int find(const char *prefix) const;
+
+public:
+	Dictionary();
+	~Dictionary();
+
+	/* Opens the dictionary of a word list: one word per line, a-z only,
+	 * optionally followed by its frequency. Builds the cached trie if it's
+	 * missing or out of date.
+	 */
+	bool open(const char *words_fname);
+	void close();
+	bool is_open() const;
+
+	int num_words() const;
+
+	/* the k most frequent words starting with prefix, other than the prefix
+	 * itself, most frequent first. Returns their number.
+	 */
+	int complete(const char *prefix, int k, std::vector<std::string> *res) const;
+};
+
+/* compiles the word list into the trie file image buf */
+bool build_dict(const char *words_fname, uint64_t hash, std::vector<unsigned char> *buf);
+
+#endif	/* DICT_H_ */
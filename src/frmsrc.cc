@@ -0,0 +1,299 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "frmsrc.h"
+#include "timer.h"
+
+#define DEF_REPLAY_FPS	30.0
+
+static void pace_frame(unsigned long start_msec, long frame, double fps);
+
+FrameSource::~FrameSource()
+{
+}
+
+bool FrameSource::ground_truth(float *vel_x) const
+{
+	return false;
+}
+
+/* ---- live camera ---- */
+
+CamSource::CamSource(int dev)
+{
+	msec = 0;
+	if(!cap.open(dev)) {
+		fprintf(stderr, "failed to open video capture device %d\n", dev);
+	}
+}
+
+bool CamSource::is_open() const
+{
+	return cap.isOpened();
+}
+
+bool CamSource::grab(cv::Mat &img)
+{
+	if(!cap.read(img) || img.empty()) {
+		return false;
+	}
+	msec = get_msec();
+	return true;
+}
+
+unsigned long CamSource::timestamp() const
+{
+	return msec;
+}
+
+/* ---- file / image sequence replay ---- */
+
+ReplaySource::ReplaySource(const char *fname, PaceMode pace, double fps)
+{
+	this->pace = pace;
+	start_msec = 0;
+	num_frames = 0;
+
+	if(!cap.open(fname)) {
+		fprintf(stderr, "failed to open %s for replay\n", fname);
+	}
+
+	if(fps <= 0.0 && (fps = cap.get(CV_CAP_PROP_FPS)) <= 0.0) {
+		fps = DEF_REPLAY_FPS;
+	}
+	this->fps = fps;
+}
+
+bool ReplaySource::is_open() const
+{
+	return cap.isOpened();
+}
+
+bool ReplaySource::grab(cv::Mat &img)
+{
+	if(!cap.read(img) || img.empty()) {
+		return false;
+	}
+
+	if(pace == PACE_REALTIME) {
+		if(!num_frames) {
+			start_msec = get_msec();
+		}
+		pace_frame(start_msec, num_frames, fps);
+	}
+	num_frames++;
+	return true;
+}
+
+unsigned long ReplaySource::timestamp() const
+{
+	return num_frames > 0 ? (unsigned long)((num_frames - 1) * 1000.0 / fps) : 0;
+}
+
+/* ---- raw recording replay ---- */
+
+RecSource::RecSource(const char *fname, PaceMode pace)
+{
+	this->pace = pace;
+	start_msec = 0;
+	cur = 0;
+	pace_base = -1;
+
+	rec.open(fname);
+}
+
+bool RecSource::is_open() const
+{
+	return rec.num_frames() > 0;
+}
+
+bool RecSource::grab(cv::Mat &img)
+{
+	if(cur >= rec.num_frames()) {
+		return false;
+	}
+
+	if(pace == PACE_REALTIME) {
+		unsigned long now = get_msec();
+		if(pace_base < 0) {
+			start_msec = now;
+			pace_base = cur;
+		}
+		/* recorded timestamps may go backwards, don't let that wrap */
+		long ahead = (long)(start_msec - now) +
+			(long)((int64_t)rec.meta(cur)->msec - (int64_t)rec.meta(pace_base)->msec);
+		if(ahead > 0) {
+			sleep_msec(ahead);
+		}
+	}
+
+	img = rec.frame(cur++);
+	return true;
+}
+
+unsigned long RecSource::timestamp() const
+{
+	const RecFrameMeta *m = meta();
+	return m ? m->msec : 0;
+}
+
+bool RecSource::ground_truth(float *vel_x) const
+{
+	const RecFrameMeta *m = meta();
+
+	if(!m || !(m->flags & REC_HAS_TRUTH)) {
+		return false;
+	}
+	*vel_x = m->truth;
+	return true;
+}
+
+void RecSource::seek(long idx)
+{
+	cur = std::max(0L, std::min(idx, rec.num_frames()));
+	pace_base = -1;
+}
+
+const RecFrameMeta *RecSource::meta() const
+{
+	return cur > 0 ? rec.meta(cur - 1) : 0;
+}
+
+/* ---- synthetic generator ---- */
+
+SynthSource::SynthSource(int width, int height, float vel_x, float noise_sigma,
+		long max_frames, PaceMode pace)
+{
+	this->vel_x = vel_x;
+	this->noise_sigma = noise_sigma;
+	this->max_frames = max_frames;
+	this->pace = pace;
+	fps = DEF_REPLAY_FPS;
+	start_msec = 0;
+	num_frames = 0;
+	disp_x = 0.0;
+
+	/* low frequency texture for the background, high frequency for the
+	 * patch so that it has plenty of corners to track
+	 */
+	bg.create(height, width, CV_8UC3);
+	cv::randu(bg, cv::Scalar::all(0), cv::Scalar::all(255));
+	cv::GaussianBlur(bg, bg, cv::Size(15, 15), 5.0);
+
+	patch.create(height / 2, width / 4, CV_8UC3);
+	cv::randu(patch, cv::Scalar::all(0), cv::Scalar::all(255));
+	cv::GaussianBlur(patch, patch, cv::Size(3, 3), 1.0);
+
+	pos_x = (width - patch.cols) / 2;
+}
+
+bool SynthSource::is_open() const
+{
+	return !bg.empty();
+}
+
+bool SynthSource::grab(cv::Mat &img)
+{
+	if(max_frames && num_frames >= max_frames) {
+		return false;
+	}
+
+	if(num_frames) {
+		float x = pos_x + vel_x;
+		if(x < 0 || x + patch.cols > bg.cols) {
+			vel_x = -vel_x;
+			x = pos_x + vel_x;
+		}
+		disp_x = floor(x + 0.5) - floor(pos_x + 0.5);
+		pos_x = x;
+	}
+
+	bg.copyTo(img);
+
+	cv::Rect rect((int)floor(pos_x + 0.5), (bg.rows - patch.rows) / 2, patch.cols, patch.rows);
+	cv::Mat dest = img(rect);
+	patch.copyTo(dest);
+
+	if(noise_sigma > 0.0) {
+		noise.create(img.rows, img.cols, CV_16SC3);
+		cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(noise_sigma));
+		cv::add(img, noise, img, cv::Mat(), CV_8UC3);
+	}
+
+	if(pace == PACE_REALTIME) {
+		if(!num_frames) {
+			start_msec = get_msec();
+		}
+		pace_frame(start_msec, num_frames, fps);
+	}
+	num_frames++;
+	return true;
+}
+
+unsigned long SynthSource::timestamp() const
+{
+	return num_frames > 0 ? (unsigned long)((num_frames - 1) * 1000.0 / fps) : 0;
+}
+
+bool SynthSource::ground_truth(float *vel_x) const
+{
+	*vel_x = disp_x;
+	return num_frames > 1;
+}
+
+float SynthSource::velocity() const
+{
+	return disp_x;
+}
+
+
+FrameSource *create_frame_source(const char *spec, PaceMode pace)
+{
+	FrameSource *src;
+
+	if(strncmp(spec, "cam:", 4) == 0) {
+		src = new CamSource(atoi(spec + 4));
+	} else if(strcmp(spec, "synth") == 0) {
+		src = new SynthSource(640, 480, 8.0, 2.0, 0, pace);
+	} else if(strlen(spec) > 6 && strcmp(spec + strlen(spec) - 6, ".vkrec") == 0) {
+		src = new RecSource(spec, pace);
+	} else {
+		src = new ReplaySource(spec, pace);
+	}
+
+	if(!src->is_open()) {
+		delete src;
+		return 0;
+	}
+	return src;
+}
+
+static void pace_frame(unsigned long start_msec, long frame, double fps)
+{
+	unsigned long due = start_msec + (unsigned long)(frame * 1000.0 / fps);
+	unsigned long now = get_msec();
+
+	if(due > now) {
+		sleep_msec(due - now);
+	}
+}
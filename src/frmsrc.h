@@ -0,0 +1,149 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRMSRC_H_
+#define FRMSRC_H_
+
+#include <opencv2/opencv.hpp>
+#include "recfile.h"
+
+/* pacing of the non-live sources */
+enum PaceMode {
+	PACE_REALTIME,	/* deliver frames at the source frame rate */
+	PACE_FAST		/* deliver frames as fast as they are requested */
+};
+
+class FrameSource {
+public:
+	virtual ~FrameSource();
+
+	virtual bool is_open() const = 0;
+
+	/* grabs the next (unmirrored) BGR frame, returns false at the end of the stream */
+	virtual bool grab(cv::Mat &img) = 0;
+
+	/* timestamp of the last grabbed frame in msec: the capture time (see
+	 * get_msec) for live sources, and the time into the stream for the rest,
+	 * so that time-dependent motion analysis replays the same regardless of
+	 * pacing
+	 */
+	virtual unsigned long timestamp() const = 0;
+
+	/* horizontal motion of the last grabbed frame in the unmirrored image,
+	 * for sources which know it. Returns false otherwise.
+	 */
+	virtual bool ground_truth(float *vel_x) const;
+};
+
+/* live camera */
+class CamSource : public FrameSource {
+private:
+	cv::VideoCapture cap;
+	unsigned long msec;
+
+public:
+	CamSource(int dev = 0);
+
+	bool is_open() const;
+	bool grab(cv::Mat &img);
+	unsigned long timestamp() const;
+};
+
+/* recorded video file, or an image sequence given as a printf-style pattern
+ * (for example "frames/%04d.png")
+ */
+class ReplaySource : public FrameSource {
+private:
+	cv::VideoCapture cap;
+	PaceMode pace;
+	double fps;
+	unsigned long start_msec;
+	long num_frames;
+
+public:
+	ReplaySource(const char *fname, PaceMode pace = PACE_REALTIME, double fps = 0.0);
+
+	bool is_open() const;
+	bool grab(cv::Mat &img);
+	/* frame index over the frame rate of the file */
+	unsigned long timestamp() const;
+};
+
+/* recording made with the record mode of the capture pipeline (see
+ * recfile.h). Frames are returned straight out of the mapped file, without
+ * copying, and are paced by their recorded timestamps. The ground truth of
+ * the recorded source is replayed too.
+ */
+class RecSource : public FrameSource {
+private:
+	RecReader rec;
+	PaceMode pace;
+	unsigned long start_msec;
+	long cur;
+	long pace_base;			/* frame the pacing started at, -1 if not yet */
+
+public:
+	RecSource(const char *fname, PaceMode pace = PACE_REALTIME);
+
+	bool is_open() const;
+	bool grab(cv::Mat &img);
+	/* the recorded timestamp */
+	unsigned long timestamp() const;
+	bool ground_truth(float *vel_x) const;
+
+	/* the next grab returns frame idx */
+	void seek(long idx);
+	/* metadata recorded with the last grabbed frame */
+	const RecFrameMeta *meta() const;
+};
+
+/* textured background with a textured patch bouncing left and right over it
+ * at a known horizontal velocity, plus gaussian noise
+ */
+class SynthSource : public FrameSource {
+private:
+	cv::Mat bg, patch, noise;
+	float pos_x, vel_x, disp_x;
+	float noise_sigma;
+	PaceMode pace;
+	double fps;
+	unsigned long start_msec;
+	long num_frames, max_frames;
+
+public:
+	SynthSource(int width = 640, int height = 480, float vel_x = 8.0,
+			float noise_sigma = 2.0, long max_frames = 0, PaceMode pace = PACE_FAST);
+
+	bool is_open() const;
+	bool grab(cv::Mat &img);
+	/* frame index over a nominal 30 fps */
+	unsigned long timestamp() const;
+	bool ground_truth(float *vel_x) const;
+
+	/* horizontal velocity (pixels per frame) of the patch in the last frame
+	 * returned by grab, in the unmirrored camera image
+	 */
+	float velocity() const;
+};
+
+/* "cam:N", "synth", a recording (*.vkrec), or anything else is treated as a
+ * file name to replay
+ */
+FrameSource *create_frame_source(const char *spec, PaceMode pace = PACE_REALTIME);
+
+#endif	/* FRMSRC_H_ */
@@ -0,0 +1,142 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include "governor.h"
+#include "motion.h"
+
+QualityGovernor::QualityGovernor(const MotionParams *base, unsigned long budget_usec)
+{
+	this->base = base;
+	this->budget_usec = budget_usec;
+	high = 0.9;
+	low = 0.5;
+	settle = 15;
+	smooth = 0.1;
+	min_features = 40;
+	min_scale = 0.25;
+	min_levels = 1;
+
+	avg_usec = 0.0;
+	have_avg = false;
+	hold = 0;
+
+	st.frames = st.over_budget = 0;
+	st.downgrades = st.upgrades = 0;
+	st.avg_usec = 0.0;
+	st.num_features = base->num_features;
+	st.pyr_levels = base->pyr_levels;
+	st.proc_scale = base->proc_scale;
+}
+
+bool QualityGovernor::update(unsigned long usec, float scale_floor, unsigned int settings,
+		MotionParams *mp)
+{
+	st.frames++;
+	if(usec > budget_usec) {
+		st.over_budget++;
+	}
+
+	if(have_avg) {
+		avg_usec += (usec - avg_usec) * smooth;
+	} else {
+		avg_usec = usec;
+		have_avg = true;
+	}
+	st.avg_usec = avg_usec;
+
+	if(hold > 0) {
+		hold--;
+		return false;
+	}
+
+	bool changed = false;
+	if(avg_usec > budget_usec * high) {
+		if((changed = downgrade(mp, scale_floor, settings))) {
+			st.downgrades++;
+		}
+	} else if(avg_usec < budget_usec * low) {
+		if((changed = upgrade(mp, settings))) {
+			st.upgrades++;
+		}
+	}
+
+	if(changed) {
+		/* the average reflects the old settings, start over */
+		have_avg = false;
+		hold = settle;
+		st.num_features = mp->num_features;
+		st.pyr_levels = mp->pyr_levels;
+		st.proc_scale = mp->proc_scale;
+	}
+	return changed;
+}
+
+bool QualityGovernor::downgrade(MotionParams *mp, float scale_floor,
+		unsigned int settings) const
+{
+	float lowest = std::max(min_scale, scale_floor);
+
+	if((settings & ENGINE_FEATURES) && mp->num_features > min_features) {
+		mp->num_features = std::max(min_features, mp->num_features * 3 / 4);
+		return true;
+	}
+	if(mp->proc_scale > lowest) {
+		mp->proc_scale = std::max(lowest, mp->proc_scale * 0.75f);
+		return true;
+	}
+	if((settings & ENGINE_LEVELS) && mp->pyr_levels > min_levels) {
+		mp->pyr_levels--;
+		return true;
+	}
+	return false;
+}
+
+bool QualityGovernor::upgrade(MotionParams *mp, unsigned int settings) const
+{
+	if((settings & ENGINE_LEVELS) && mp->pyr_levels < base->pyr_levels) {
+		mp->pyr_levels++;
+		return true;
+	}
+	if(mp->proc_scale < base->proc_scale) {
+		mp->proc_scale = std::min(base->proc_scale, mp->proc_scale / 0.75f);
+		return true;
+	}
+	if((settings & ENGINE_FEATURES) && mp->num_features < base->num_features) {
+		mp->num_features = std::min(base->num_features, mp->num_features * 4 / 3 + 1);
+		return true;
+	}
+	return false;
+}
+
+const GovernorStats *QualityGovernor::stats() const
+{
+	return &st;
+}
+
+void print_governor_stats(FILE *fp, const GovernorStats *st)
+{
+	if(!st->frames) {
+		return;
+	}
+	fprintf(fp, "quality governor: %lu of %lu frames over budget, %lu downgrades, %lu upgrades\n",
+			st->over_budget, st->frames, st->downgrades, st->upgrades);
+	fprintf(fp, "  final: %d features, %d pyramid levels, scale %.3f, %.3f ms/frame\n",
+			st->num_features, st->pyr_levels, st->proc_scale, st->avg_usec / 1000.0);
+}
@@ -0,0 +1,80 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GOVERNOR_H_
+#define GOVERNOR_H_
+
+#include <stdio.h>
+
+struct MotionParams;
+
+struct GovernorStats {
+	unsigned long frames;		/* frames measured */
+	unsigned long over_budget;	/* of which took longer than the budget */
+	unsigned long downgrades, upgrades;
+	float avg_usec;				/* smoothed motion analysis time */
+	/* current settings */
+	int num_features;
+	int pyr_levels;
+	float proc_scale;
+};
+
+/* Holds the processing time of each frame within a budget, by trading
+ * quality for speed. Over budget it first reduces the tracked features, then
+ * the processing scale, then the pyramid levels, and when well under budget
+ * it restores them in the opposite order, up to the initial settings. Settings
+ * the motion engine doesn't use are left alone. After every change it waits
+ * for the cost to settle before the next one.
+ */
+class QualityGovernor {
+private:
+	const MotionParams *base;	/* initial, maximum quality settings */
+	float avg_usec;
+	bool have_avg;
+	int hold;					/* frames until the next change is allowed */
+	GovernorStats st;
+
+	bool downgrade(MotionParams *mp, float scale_floor, unsigned int settings) const;
+	bool upgrade(MotionParams *mp, unsigned int settings) const;
+
+public:
+	unsigned long budget_usec;
+	float high, low;		/* fractions of the budget to downgrade/upgrade at */
+	int settle;				/* frames to wait after a change */
+	float smooth;			/* weight of new samples in the average */
+	int min_features;
+	float min_scale;
+	int min_levels;
+
+	QualityGovernor(const MotionParams *base, unsigned long budget_usec);
+
+	/* feeds the processing time of a frame which went through motion
+	 * analysis, and adjusts mp if needed. The processing scale isn't lowered
+	 * under scale_floor, the smallest the motion engine can work at on the
+	 * current frames, and only the ENGINE_* settings it uses are changed.
+	 * Returns true if mp changed.
+	 */
+	bool update(unsigned long usec, float scale_floor, unsigned int settings,
+			MotionParams *mp);
+
+	const GovernorStats *stats() const;
+};
+
+void print_governor_stats(FILE *fp, const GovernorStats *st);
+
+#endif	/* GOVERNOR_H_ */
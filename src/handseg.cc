@@ -0,0 +1,159 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <algorithm>
+#include "handseg.h"
+
+HandSegmenter::HandSegmenter()
+{
+	decimate = 4;
+	alpha = 0.05;
+	alpha_fg = 0.002;
+	thres = 20;
+	min_pixels = 20;
+	smooth = 0.5;
+	margin = 0.25;
+	hold = 10;
+	warmup = 10;
+
+	reset();
+}
+
+void HandSegmenter::reset()
+{
+	bg.release();
+	have_win = false;
+	lost = 0;
+	num_frames = 0;
+}
+
+bool HandSegmenter::segment(const cv::Mat &gray)
+{
+	int xsz = gray.cols / decimate;
+	int ysz = gray.rows / decimate;
+
+	small.create(ysz, xsz, CV_8UC1);
+	for(int i=0; i<ysz; i++) {
+		const unsigned char *src = gray.ptr(i * decimate);
+		unsigned char *dest = small.ptr(i);
+
+		for(int j=0; j<xsz; j++) {
+			dest[j] = src[j * decimate];
+		}
+	}
+
+	if(bg.empty() || bg.size() != small.size()) {
+		reset();
+		small.convertTo(bg, CV_32FC1);
+	}
+	num_frames++;
+
+	/* classify and update the background in the same pass */
+	fg.create(ysz, xsz, CV_8UC1);
+	int x0 = xsz, y0 = ysz, x1 = -1, y1 = -1;
+	int count = 0;
+
+	for(int i=0; i<ysz; i++) {
+		const unsigned char *src = small.ptr(i);
+		float *bgrow = bg.ptr<float>(i);
+		unsigned char *fgrow = fg.ptr(i);
+
+		for(int j=0; j<xsz; j++) {
+			float diff = src[j] - bgrow[j];
+			bool fore = abs((int)diff) > thres;
+
+			bgrow[j] += diff * (fore ? alpha_fg : alpha);
+			fgrow[j] = fore ? 255 : 0;
+
+			if(fore) {
+				if(j < x0) x0 = j;
+				if(j > x1) x1 = j;
+				if(i < y0) y0 = i;
+				if(i > y1) y1 = i;
+				count++;
+			}
+		}
+	}
+
+	if(num_frames <= warmup) {
+		return false;
+	}
+
+	if(count < min_pixels) {
+		if(!have_win || ++lost > hold) {
+			have_win = false;
+			return false;
+		}
+	} else {
+		cv::Rect_<float> box(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+		if(have_win) {
+			win.x += (box.x - win.x) * smooth;
+			win.y += (box.y - win.y) * smooth;
+			win.width += (box.width - win.width) * smooth;
+			win.height += (box.height - win.height) * smooth;
+		} else {
+			win = box;
+			have_win = true;
+		}
+		lost = 0;
+	}
+
+	/* the mask is the dilated foreground inside the grown window, so that
+	 * corners on the edges of the hand are kept
+	 */
+	cv::Rect w = window();
+	cv::Rect sw(w.x / decimate, w.y / decimate, w.width / decimate, w.height / decimate);
+	sw &= cv::Rect(0, 0, xsz, ysz);
+
+	cv::dilate(fg, fg_dil, cv::Mat());
+	clip.create(fg_dil.size(), CV_8UC1);
+	clip.setTo(cv::Scalar::all(0));
+	cv::Mat dest = clip(sw);
+	fg_dil(sw).copyTo(dest);
+
+	/* decimated pixel (i, j) was sampled at (i, j) * decimate, expand it over
+	 * the decimate x decimate block from there, and the last row and column
+	 * over the remainder of the frame
+	 */
+	msk.create(gray.size(), CV_8UC1);
+	for(int i=0; i<gray.rows; i++) {
+		const unsigned char *src = clip.ptr(std::min(i / decimate, ysz - 1));
+		unsigned char *dest = msk.ptr(i);
+
+		for(int j=0; j<gray.cols; j++) {
+			dest[j] = src[std::min(j / decimate, xsz - 1)];
+		}
+	}
+	return true;
+}
+
+const cv::Mat &HandSegmenter::mask() const
+{
+	return msk;
+}
+
+cv::Rect HandSegmenter::window() const
+{
+	float mx = win.width * margin;
+	float my = win.height * margin;
+	cv::Rect r((int)((win.x - mx) * decimate), (int)((win.y - my) * decimate),
+			(int)((win.width + mx * 2.0) * decimate), (int)((win.height + my * 2.0) * decimate));
+
+	return r & cv::Rect(0, 0, bg.cols * decimate, bg.rows * decimate);
+}
@@ -0,0 +1,67 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HANDSEG_H_
+#define HANDSEG_H_
+
+#include <opencv2/opencv.hpp>
+
+/* Segments the moving hand out of the static background, so that motion
+ * analysis only looks at it. A running average of the decimated frame models
+ * the background, and pixels which differ from it are foreground. The
+ * background adapts quickly where the frame matches it and very slowly under
+ * the foreground, so that the hand isn't absorbed while it moves, but objects
+ * which stop moving eventually are. A smoothed bounding window tracks the
+ * foreground, and the mask is the dilated foreground within that window.
+ */
+class HandSegmenter {
+private:
+	cv::Mat small, bg;		/* decimated frame and background (float) */
+	cv::Mat fg, fg_dil, clip;	/* decimated foreground */
+	cv::Mat msk;			/* foreground mask at input resolution */
+	cv::Rect_<float> win;	/* tracked window, in decimated pixels */
+	bool have_win;
+	int lost;				/* frames since the foreground disappeared */
+	int num_frames;
+
+public:
+	int decimate;			/* background model resolution divisor */
+	float alpha;			/* background adaptation rate */
+	float alpha_fg;			/* adaptation rate under the foreground */
+	int thres;				/* difference from the background which is foreground */
+	int min_pixels;			/* decimated foreground pixels below which nothing moves */
+	float smooth;			/* weight of the new bounding box in the window */
+	float margin;			/* window growth, as a fraction of its size */
+	int hold;				/* frames to keep the window after losing the foreground */
+	int warmup;				/* frames to learn the background before segmenting */
+
+	HandSegmenter();
+
+	/* updates the background with the frame and segments it. Returns false
+	 * if there is no foreground window (yet), and the whole frame should be
+	 * analysed.
+	 */
+	bool segment(const cv::Mat &gray);
+	void reset();
+
+	/* valid after segment returns true */
+	const cv::Mat &mask() const;
+	cv::Rect window() const;	/* in input pixels */
+};
+
+#endif	/* HANDSEG_H_ */
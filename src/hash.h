@@ -0,0 +1,38 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_INIT	0xcbf29ce484222325ull
+
+/* 64bit FNV-1a of data, continuing from hash (HASH_INIT to start) */
+inline uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *ptr = (const unsigned char*)data;
+
+	for(size_t i=0; i<size; i++) {
+		hash = (hash ^ ptr[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+#endif	/* HASH_H_ */
@@ -0,0 +1,313 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+#include "keyinject.h"
+
+KeyInjector::KeyInjector()
+{
+	dpy = 0;
+	root = 0;
+	xtest = false;
+	min_code = max_code = syms_per_code = 0;
+	map = 0;
+	modmap = 0;
+	next_spare = 0;
+	shift_code = 0;
+	focus = None;
+	net_active = None;
+	num_cleared_keys = 0;
+	pending = 0;
+	num_keys = num_remaps = num_flushes = num_cleared = 0;
+}
+
+KeyInjector::~KeyInjector()
+{
+	if(map) {
+		XFree(map);
+	}
+	if(modmap) {
+		XFreeModifiermap(modmap);
+	}
+}
+
+bool KeyInjector::init(Display *dpy)
+{
+	int evbase, errbase, major, minor;
+
+	this->dpy = dpy;
+	root = DefaultRootWindow(dpy);
+
+	if(!(xtest = XTestQueryExtension(dpy, &evbase, &errbase, &major, &minor))) {
+		fprintf(stderr, "XTest extension not available, falling back to XSendEvent\n");
+	}
+
+	if(!load_mapping()) {
+		fprintf(stderr, "failed to get the keyboard mapping\n");
+		return false;
+	}
+
+	/* keycodes without any keysyms are free to remap */
+	for(int i=0; i<=max_code - min_code; i++) {
+		KeySym *row = map + i * syms_per_code;
+		int j;
+		for(j=0; j<syms_per_code && row[j] == NoSymbol; j++);
+		if(j == syms_per_code) {
+			spare.push_back(min_code + i);
+		}
+	}
+
+	if(!xtest) {
+		if((net_active = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", True)) != None) {
+			XSelectInput(dpy, root, PropertyChangeMask);
+		}
+		update_focus();
+	}
+	return true;
+}
+
+bool KeyInjector::load_mapping()
+{
+	XDisplayKeycodes(dpy, &min_code, &max_code);
+
+	if(map) {
+		XFree(map);
+	}
+	if(!(map = XGetKeyboardMapping(dpy, min_code, max_code - min_code + 1, &syms_per_code))) {
+		return false;
+	}
+
+	if(modmap) {
+		XFreeModifiermap(modmap);
+	}
+	if(!(modmap = XGetModifierMapping(dpy))) {
+		return false;
+	}
+	shift_code = 0;
+	for(int i=0; i<modmap->max_keypermod; i++) {
+		if((shift_code = modmap->modifiermap[ShiftMapIndex * modmap->max_keypermod + i])) {
+			break;
+		}
+	}
+	return true;
+}
+
+/* only the first group counts: unshifted, then shifted */
+int KeyInjector::lookup(KeySym sym, bool *shift) const
+{
+	int num_codes = max_code - min_code + 1;
+
+	for(int col=0; col<2 && col<syms_per_code; col++) {
+		if(col == 1 && !shift_code) {
+			break;
+		}
+		for(int i=0; i<num_codes; i++) {
+			if(map[i * syms_per_code + col] == sym) {
+				*shift = col == 1;
+				return min_code + i;
+			}
+		}
+	}
+	return -1;
+}
+
+/* Maps sym on the next spare keycode. A keycode only gets reused after all
+ * the others, so clients have long caught up with its previous mapping by
+ * then.
+ */
+int KeyInjector::remap(KeySym sym)
+{
+	if(spare.empty()) {
+		return -1;
+	}
+	int code = spare[next_spare];
+	next_spare = (next_spare + 1) % spare.size();
+
+	/* the keysym goes in the shifted column too, otherwise a lone uppercase
+	 * keysym would be taken as the shifted form of its lowercase one
+	 */
+	KeySym *row = map + (code - min_code) * syms_per_code;
+	for(int i=0; i<syms_per_code; i++) {
+		row[i] = i < 2 ? sym : NoSymbol;
+	}
+	XChangeKeyboardMapping(dpy, code, syms_per_code, row, 1);
+
+	num_remaps++;
+	return code;
+}
+
+void KeyInjector::begin_burst(unsigned int held)
+{
+	num_cleared_keys = 0;
+
+	/* XSendEvent carries its own modifier state, only fake input needs the
+	 * modifiers the user is holding down released first
+	 */
+	if(xtest && (held & 0xff)) {
+		char keys[32];
+		XQueryKeymap(dpy, keys);
+
+		for(int mod=0; mod<8; mod++) {
+			if(!(held & (1 << mod))) continue;
+
+			for(int i=0; i<modmap->max_keypermod && i<8; i++) {
+				int kc = modmap->modifiermap[mod * modmap->max_keypermod + i];
+				if(kc && (keys[kc / 8] & (1 << (kc % 8)))) {
+					key_event(kc, false, 0);
+					cleared[num_cleared_keys++] = kc;
+				}
+			}
+		}
+		num_cleared++;
+	}
+}
+
+void KeyInjector::end_burst()
+{
+	for(int i=0; i<num_cleared_keys; i++) {
+		key_event(cleared[i], true, 0);
+	}
+	num_cleared_keys = 0;
+}
+
+void KeyInjector::type(KeySym sym)
+{
+	bool shift = false;
+	int code;
+
+	if((code = lookup(sym, &shift)) == -1 && (code = remap(sym)) == -1) {
+		const char *name = XKeysymToString(sym);
+		fprintf(stderr, "no keycode available for keysym %s\n", name ? name : "<unknown>");
+		return;
+	}
+
+	unsigned int state = shift ? ShiftMask : 0;
+	if(shift) {
+		key_event(shift_code, true, 0);
+	}
+	key_event(code, true, state);
+	key_event(code, false, state);
+	if(shift) {
+		key_event(shift_code, false, state);
+	}
+	num_keys++;
+}
+
+void KeyInjector::flush()
+{
+	if(pending) {
+		XFlush(dpy);
+		pending = 0;
+		num_flushes++;
+	}
+}
+
+void KeyInjector::key_event(int code, bool press, unsigned int state)
+{
+	if(xtest) {
+		XTestFakeKeyEvent(dpy, code, press, 0);
+	} else {
+		XEvent ev;
+
+		memset(&ev, 0, sizeof ev);
+		ev.type = press ? KeyPress : KeyRelease;
+		ev.xkey.display = dpy;
+		ev.xkey.window = focus != None ? focus : root;
+		ev.xkey.root = root;
+		ev.xkey.subwindow = None;
+		ev.xkey.time = CurrentTime;
+		ev.xkey.same_screen = True;
+		ev.xkey.keycode = code;
+		ev.xkey.state = state;
+
+		XSendEvent(dpy, InputFocus, False, NoEventMask, &ev);
+	}
+	pending++;
+}
+
+void KeyInjector::update_focus()
+{
+	if(net_active != None) {
+		Atom type;
+		int fmt;
+		unsigned long count, after;
+		unsigned char *data = 0;
+
+		if(XGetWindowProperty(dpy, root, net_active, 0, 1, False, XA_WINDOW, &type, &fmt,
+					&count, &after, &data) == Success && data) {
+			focus = count ? *(Window*)data : None;
+			XFree(data);
+			return;
+		}
+	}
+
+	int revert;
+	XGetInputFocus(dpy, &focus, &revert);
+	if(focus == PointerRoot) {
+		focus = None;
+	}
+}
+
+bool KeyInjector::handle_event(const XEvent *xev)
+{
+	switch(xev->type) {
+	case MappingNotify:
+		{
+			XMappingEvent mev = xev->xmapping;
+			XRefreshKeyboardMapping(&mev);
+
+			/* our own remaps are already in the cached mapping */
+			if(mev.request == MappingKeyboard && mev.count == 1 &&
+					std::find(spare.begin(), spare.end(), mev.first_keycode) != spare.end()) {
+				return true;
+			}
+			if(mev.request != MappingPointer) {
+				load_mapping();
+			}
+		}
+		return true;
+
+	case PropertyNotify:
+		if(xev->xproperty.window == root && xev->xproperty.atom == net_active) {
+			update_focus();
+			return true;
+		}
+		break;
+
+	default:
+		break;
+	}
+	return false;
+}
+
+void KeyInjector::print_stats(FILE *fp) const
+{
+	if(!num_keys) {
+		return;
+	}
+	fprintf(fp, "key injection (%s): %lu keys in %lu flushes, %lu keysyms remapped",
+			xtest ? "XTest" : "XSendEvent", num_keys, num_flushes, num_remaps);
+	if(num_cleared) {
+		fprintf(fp, ", held modifiers cleared %lu times", num_cleared);
+	}
+	fputc('\n', fp);
+}
@@ -0,0 +1,90 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KEYINJECT_H_
+#define KEYINJECT_H_
+
+#include <stdio.h>
+#include <vector>
+#include <X11/Xlib.h>
+
+/* Injects typed keys into whichever window has the input focus, through the
+ * XTest extension. Keysyms without a keycode in the current keyboard mapping
+ * are mapped on demand onto spare keycodes, which are reused round robin. Key
+ * events are only queued in the Xlib output buffer, and a burst of them goes
+ * out with a single flush. The keyboard mapping is cached and kept up to date
+ * through MappingNotify events, so injecting a key takes no round trips; a
+ * burst of keys typed while modifiers are held takes one, see begin_burst.
+ *
+ * Without XTest, keys are sent to the focus window with XSendEvent instead,
+ * which many clients ignore. The focus window is then tracked through the
+ * _NET_ACTIVE_WINDOW property of the root window.
+ */
+class KeyInjector {
+private:
+	Display *dpy;
+	Window root;
+	bool xtest;
+
+	int min_code, max_code, syms_per_code;
+	KeySym *map;				/* keyboard mapping, syms_per_code per keycode */
+	XModifierKeymap *modmap;
+	std::vector<int> spare;		/* keycodes without keysyms, for remapping */
+	int next_spare;
+	int shift_code;
+
+	Window focus;
+	Atom net_active;
+
+	int cleared[8 * 8];			/* modifier keys released for the burst */
+	int num_cleared_keys;
+
+	int pending;				/* key events queued since the last flush */
+	unsigned long num_keys, num_remaps, num_flushes, num_cleared;
+
+	bool load_mapping();
+	int lookup(KeySym sym, bool *shift) const;
+	int remap(KeySym sym);
+	void key_event(int code, bool press, unsigned int state);
+	void update_focus();
+
+public:
+	KeyInjector();
+	~KeyInjector();
+
+	bool init(Display *dpy);
+
+	/* Bracket the keys typed in response to one key event. held is the
+	 * modifier state of that event, those modifiers are released for the
+	 * burst so its keys aren't turned into shortcuts, and pressed again at
+	 * the end. Finding out which modifier keys are down costs one round trip
+	 * per burst, and none if nothing is held.
+	 */
+	void begin_burst(unsigned int held);
+	void end_burst();
+	/* queues a press and release of sym. Nothing is sent until flush. */
+	void type(KeySym sym);
+	void flush();
+
+	/* feed with every X event, returns true if the event was consumed */
+	bool handle_event(const XEvent *xev);
+
+	void print_stats(FILE *fp) const;
+};
+
+#endif	/* KEYINJECT_H_ */
@@ -0,0 +1,59 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mailbox.h"
+
+#define FRESH	4
+#define IDX(x)	((x) & 3)
+
+FrameMailbox::FrameMailbox()
+{
+	for(int i=0; i<3; i++) {
+		slots[i].dir = 0.0;
+		slots[i].motion_vec = cv::Point2f(0, 0);
+		slots[i].msec = 0;
+		slots[i].seq = 0;
+	}
+	back = 0;
+	middle = 1;
+	front = 2;
+}
+
+FrameSlot *FrameMailbox::back_slot()
+{
+	return slots + back;
+}
+
+void FrameMailbox::publish()
+{
+	back = IDX(middle.exchange(back | FRESH, std::memory_order_acq_rel));
+}
+
+FrameSlot *FrameMailbox::fetch()
+{
+	if(!(middle.load(std::memory_order_acquire) & FRESH)) {
+		return 0;
+	}
+	front = IDX(middle.exchange(front, std::memory_order_acq_rel));
+	return slots + front;
+}
+
+FrameSlot *FrameMailbox::front_slot()
+{
+	return slots[front].seq ? slots + front : 0;
+}
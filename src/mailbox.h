@@ -0,0 +1,74 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <atomic>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+struct FrameSlot {
+	cv::Mat img;			/* mirrored BGR frame */
+	double dir;				/* motion direction computed for this frame */
+	/* motion overlay, in frame coordinates: flow vectors as line segment
+	 * endpoint pairs, and the global translation since the previous frame.
+	 * Empty when the overlay is disabled.
+	 */
+	std::vector<cv::Point2f> flow;
+	cv::Point2f motion_vec;
+	cv::Rect hand;			/* segmented hand window, empty if none */
+	/* img downscaled to the preview size of motion_params, as RGB565
+	 * (CV_8UC2), or empty if no preview size is set
+	 */
+	cv::Mat preview;
+	unsigned long msec;		/* source timestamp (see FrameSource::timestamp) */
+	unsigned long grab_msec;	/* get_msec() when the frame was grabbed */
+	unsigned long seq;		/* frame sequence number */
+};
+
+/* Lock-free latest-wins triple buffer between a single producer (the capture
+ * thread) and a single consumer (the render loop). The producer fills its
+ * back slot in place and publishes it, the consumer picks up the newest
+ * published slot. Neither side ever blocks or copies a frame, and slot
+ * buffers are reused once they have been allocated.
+ */
+class FrameMailbox {
+private:
+	FrameSlot slots[3];
+	int back;					/* owned by the producer */
+	int front;					/* owned by the consumer */
+	std::atomic<int> middle;	/* shared slot index, FRESH bit set if unread */
+
+public:
+	FrameMailbox();
+
+	/* producer side */
+	FrameSlot *back_slot();
+	void publish();
+
+	/* consumer side: returns the newest slot published since the last call,
+	 * or null if nothing new has been published. The slot stays valid until
+	 * the next call.
+	 */
+	FrameSlot *fetch();
+	/* last slot returned by fetch, or null */
+	FrameSlot *front_slot();
+};
+
+#endif	/* MAILBOX_H_ */
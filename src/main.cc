@@ -17,34 +17,44 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <assert.h>
+#include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include <X11/Xlib.h>
 #include <GL/gl.h>
 #include <GL/glx.h>
-#include <GL/glut.h>
 
 #include <opencv2/opencv.hpp>
 
-#include <imago2.h>
 #include "vkeyb.h"
+#include "render.h"
+#include "texstream.h"
+#include "keyinject.h"
+#include "dict.h"
+#include "bigram.h"
 #include "motion.h"
+#include "scroll.h"
+#include "timer.h"
 
+int parse_args(int argc, char **argv);
 int init(void);
 void shutdown(void);
 int create_window(int xsz, int ysz);
 void display(void);
-void show_frame(float frm_width);
 int handle_event(XEvent *xev);
 void reshape(int w, int h);
 void keyb(int key, int pressed);
 void send_key(KeySym key);
+void complete_word(const char *word);
 void motion(int x, int y);
-void cam_motion(double orient);
+void cam_motion(double orient, unsigned long msec);
 void button(int x, int y, int bn, int state);
 void activate(int enter);
 
@@ -52,20 +62,76 @@ Display *dpy;		/* X11 display structure (x server connection) */
 Window win;			/* X window */
 GLXContext ctx;		/* OpenGL context */
 
-unsigned int frm_tex;
-bool tex_created;
+TexStream *preview;
 
 double size = 0.1;
 VKeyb *vkeyb;
+Renderer *rend;
 
 int must_redraw;
 
 static double orient = 0.0;
+static ScrollCtl scroll;
+static KeyInjector injector;
+static unsigned int key_mods;	/* modifier state of the last key event */
+/* the scroll controller runs on source timestamps: source time minus
+ * get_msec() at the grab of the last frame (0 for live cameras)
+ */
+static long src_offset;
+static unsigned long src_now(void);
+
+static const char *src_spec = "cam:0";
+static const char *layout_file = "data/layout.txt";
+static const char *glyph_font = "-misc-fixed-medium-r-normal--20-*-*-*-*-*-iso10646-1";
+
+static const char *words_file = "data/words.txt";
+static int num_completions = 3;
+static Dictionary dict;
+static std::string typed_word;		/* letters typed since the last word break */
+static std::vector<std::string> completions;
+
+static void track_word(KeySym key);
+
+static const char *corpus_file = "data/corpus.txt";
+static int num_predictions;
+static BigramModel bigrams;
+static int prev_glyph = -1;
+
+static void init_predictions(void);
+static void predict_next(KeySym key);
+static PaceMode src_pace = PACE_REALTIME;
+
+/* main loop event sources, the epoll data of each */
+enum { EV_XSOCK, EV_NOTIFY, EV_TIMER };
+
+struct LoopStats {
+	unsigned long wakeups;		/* returns from epoll_wait */
+	unsigned long x_events;
+	unsigned long notified;		/* frames published by the capture thread */
+	unsigned long coalesced;	/* of which skipped for a newer one */
+	unsigned long ticks;		/* refresh timer expirations */
+	unsigned long missed_ticks;	/* expired while the loop was busy */
+	unsigned long redraws;
+};
+
+static int epfd = -1, timer_fd = -1;
+static bool timer_armed;
+static float refresh_rate = 60.0;
+static LoopStats loop_stats;
+
+static int init_loop(void);
+static void process_xevents(void);
+static void process_frames(void);
+static void refresh_tick(void);
+static void arm_timer(bool arm);
+static void print_loop_stats(FILE *fp);
 
 
 int main (int argc, char** argv)
 {
-	glutInit(&argc, argv);
+	if(parse_args(argc, argv) == -1) {
+		return 1;
+	}
 
 	if(init() == -1) {
 		return 1;
@@ -75,54 +141,251 @@ int main (int argc, char** argv)
 	glEnable(GL_CULL_FACE);
 
 	for(;;) {
-		fd_set fdset;
-
-		FD_ZERO(&fdset);
+		struct epoll_event ev[3];
 
-		//retreive the X server socket
-		int xsock = ConnectionNumber(dpy);
-		FD_SET(xsock, &fdset);
-		FD_SET(pipefd[0], &fdset);
+		// Xlib may have read events into its queue while sending requests,
+		// which doesn't wake up epoll, so drain the queue before waiting
+		process_xevents();
+		// keys typed since the last wait go out together
+		injector.flush();
 
-		int maxfd = (xsock > pipefd[0] ? xsock : pipefd[0]) + 1;
-		select(maxfd, &fdset, 0, 0, 0);
+		// redraws happen on refresh ticks, the timer only runs while needed
+		if(must_redraw && !timer_armed) {
+			arm_timer(true);
+		}
 
-		if(FD_ISSET(pipefd[0], &fdset)) {
-			// process all pending events ...
-			while(XPending(dpy)) {
-				XEvent xev;
-				XNextEvent(dpy, &xev);
-				handle_event(&xev);
+		int num = epoll_wait(epfd, ev, sizeof ev / sizeof *ev, -1);
+		if(num == -1) {
+			if(errno == EINTR) {
+				continue;
 			}
+			perror("epoll_wait failed");
+			break;
 		}
-
-		if(FD_ISSET(pipefd[0], &fdset)) {
-			if(read(pipefd[0], &orient, sizeof orient) < (int)sizeof orient) {
-				fprintf(stderr, "read from pipe failed\n");
+		loop_stats.wakeups++;
+
+		for(int i=0; i<num; i++) {
+			switch(ev[i].data.u32) {
+			case EV_XSOCK:
+				break;	// drained at the top of the loop
+			case EV_NOTIFY:
+				process_frames();
+				break;
+			case EV_TIMER:
+				refresh_tick();
+				break;
 			}
-			else {
-				glBindTexture(GL_TEXTURE_2D, frm_tex);
-				if(!tex_created) {
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frm.cols, frm.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, frm.data);
-					tex_created = true;
+		}
+	}
+
+	shutdown();
+	return 0;
+}
+
+int parse_args(int argc, char **argv)
+{
+	for(int i=1; i<argc; i++) {
+		if(argv[i][0] == '-' && argv[i][2] == 0) {
+			switch(argv[i][1]) {
+			case 's':
+				if(!argv[++i]) {
+					fprintf(stderr, "-s must be followed by a frame source\n");
+					return -1;
 				}
-				else {
-					glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frm.cols, frm.rows, GL_BGR, GL_UNSIGNED_BYTE, frm.data);
+				src_spec = argv[i];
+				break;
+
+			case 'f':
+				src_pace = PACE_FAST;
+				break;
+
+			case 'e':
+				if(!argv[++i] || !is_motion_engine(argv[i])) {
+					fprintf(stderr, "-e must be followed by a motion engine: lk, farneback, block, mhi\n");
+					return -1;
 				}
+				motion_params.engine = argv[i];
+				break;
 
-				cam_motion(orient);
-				must_redraw = true;
-			}
-		}
+			case 'l':
+				if(!argv[++i] || (motion_params.pyr_levels = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-l must be followed by the number of pyramid levels\n");
+					return -1;
+				}
+				break;
 
-		// ... and then do a single redisplay if needed
-		if(must_redraw) {
-			display();
-		}
+			case 'w':
+				if(!argv[++i] || (motion_params.win_size = atoi(argv[i])) < 3) {
+					fprintf(stderr, "-w must be followed by a window size of at least 3\n");
+					return -1;
+				}
+				break;
 
-	}
+			case 'd':
+				if(!argv[++i] || (motion_params.proc_scale = atof(argv[i])) <= 0.0) {
+					fprintf(stderr, "-d must be followed by a processing scale in (0, 1]\n");
+					return -1;
+				}
+				break;
 
-	shutdown();
+			case 'R':
+				if(!argv[++i] || parse_roi(argv[i], &motion_params.roi) == -1) {
+					fprintf(stderr, "-R must be followed by a region of interest: x,y,w,h\n");
+					return -1;
+				}
+				break;
+
+			case 'P':
+				if(!argv[++i]) {
+					fprintf(stderr, "-P must be followed by a drop policy\n");
+					return -1;
+				}
+				if(strcmp(argv[i], "none") == 0) {
+					motion_params.drop = DROP_NONE;
+				} else if(strcmp(argv[i], "stale") == 0) {
+					motion_params.drop = DROP_STALE;
+				} else {
+					fprintf(stderr, "invalid drop policy: %s\n", argv[i]);
+					return -1;
+				}
+				break;
+
+			case 'G':
+				motion_params.gate = false;
+				break;
+
+			case 'H':
+				motion_params.segment = true;
+				break;
+
+			case 'T':
+				if(!argv[++i] || (motion_params.tiles = atoi(argv[i])) < 1) {
+					fprintf(stderr, "-T must be followed by the number of tiles per side\n");
+					return -1;
+				}
+				break;
+
+			case 'j':
+				if(!argv[++i] || (motion_params.threads = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-j must be followed by the number of threads (0: one per CPU)\n");
+					return -1;
+				}
+				break;
+
+			case 'B':
+				if(!argv[++i] || (motion_params.frame_budget = atof(argv[i])) < 0.0) {
+					fprintf(stderr, "-B must be followed by a motion analysis budget in msec (0: off)\n");
+					return -1;
+				}
+				break;
+
+			case 'g':
+				if(!argv[++i] || (scroll.gain = atof(argv[i])) <= 0.0) {
+					fprintf(stderr, "-g must be followed by a positive scroll gain\n");
+					return -1;
+				}
+				break;
+
+			case 'O':
+				motion_params.overlay = false;
+				break;
+
+			case 'F':
+				if(!argv[++i] || (refresh_rate = atof(argv[i])) <= 0.0) {
+					fprintf(stderr, "-F must be followed by a positive refresh rate in Hz\n");
+					return -1;
+				}
+				break;
+
+			case 'L':
+				if(!argv[++i]) {
+					fprintf(stderr, "-L must be followed by a keyboard layout file\n");
+					return -1;
+				}
+				layout_file = argv[i];
+				break;
+
+			case 'D':
+				if(!argv[++i]) {
+					fprintf(stderr, "-D must be followed by a word list\n");
+					return -1;
+				}
+				words_file = argv[i];
+				break;
+
+			case 'k':
+				if(!argv[++i] || (num_completions = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-k must be followed by the number of completions (0: off)\n");
+					return -1;
+				}
+				break;
+
+			case 'p':
+				if(!argv[++i] || (num_predictions = atoi(argv[i])) < 0) {
+					fprintf(stderr, "-p must be followed by the number of predicted glyphs (0: off)\n");
+					return -1;
+				}
+				break;
+
+			case 'C':
+				if(!argv[++i]) {
+					fprintf(stderr, "-C must be followed by a text file\n");
+					return -1;
+				}
+				corpus_file = argv[i];
+				break;
+
+			case 'r':
+				if(!argv[++i]) {
+					fprintf(stderr, "-r must be followed by the file to record to\n");
+					return -1;
+				}
+				motion_params.record = argv[i];
+				break;
+
+			case 'h':
+				printf("usage: %s [options]\n", argv[0]);
+				printf("options:\n");
+				printf(" -s <source>  frame source: cam:<n> (default cam:0), synth, a recording (*.vkrec),\n");
+				printf("              or a video file / image sequence pattern (e.g. frames/%%04d.png)\n");
+				printf(" -f           replay as fast as possible instead of in real time\n");
+				printf(" -e <engine>  motion engine: lk, farneback, block, mhi (default %s)\n", motion_params.engine);
+				printf(" -l <levels>  optical flow pyramid levels (default %d)\n", motion_params.pyr_levels);
+				printf(" -w <size>    optical flow window size (default %d)\n", motion_params.win_size);
+				printf(" -d <scale>   run motion analysis downscaled by this factor\n");
+				printf(" -R x,y,w,h   motion analysis region, in [0, 1] frame coordinates\n");
+				printf(" -P <policy>  frame drop policy when falling behind: none, stale (default stale)\n");
+				printf(" -G           run motion analysis on static frames too\n");
+				printf(" -H           restrict motion analysis to the moving hand\n");
+				printf(" -T <n>       split lk detection and tracking into n x n tiles\n");
+				printf(" -j <threads> threads for the tiles (default: one per CPU)\n");
+				printf(" -B <msec>    adapt quality to this motion analysis budget per frame, 0 to\n");
+				printf("              disable (default %g)\n", motion_params.frame_budget);
+				printf(" -g <gain>    glyphs per second to scroll per pixel of motion per frame (default %g)\n",
+						scroll.gain);
+				printf(" -O           don't show the motion overlay\n");
+				printf(" -L <file>    keyboard layout: keysyms and labels (default %s)\n", layout_file);
+				printf(" -D <file>    word list of the completions (default %s)\n", words_file);
+				printf(" -k <n>       offer this many word completions, 0 to disable (default %d)\n",
+						num_completions);
+				printf(" -p <n>       place the n likeliest next glyphs next to the active one,\n");
+				printf("              0 to disable (default %d)\n", num_predictions);
+				printf(" -C <file>    text to seed the glyph predictions with (default %s)\n", corpus_file);
+				printf(" -F <hz>      redraw at most this often (default %g)\n", refresh_rate);
+				printf(" -r <file>    record the frames and motion results, replay with -s <file>\n");
+				printf("              (name it *.vkrec)\n");
+				printf(" -h           print usage and exit\n");
+				exit(0);
+
+			default:
+				fprintf(stderr, "invalid option: %s\n", argv[i]);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+			return -1;
+		}
+	}
 	return 0;
 }
 
@@ -147,34 +410,212 @@ int init(void)
 	XMoveWindow(dpy, win, 0, HeightOfScreen(scr) - height);
 
 	try {
-		vkeyb = new VKeyb;
+		vkeyb = new VKeyb(dpy, layout_file, glyph_font);
 	}
 	catch(...) {
 		fprintf(stderr, "failed to initialize virtual keyboard\n");
 		return -1;
 	}
 
+	rend = new Renderer;
+	if(!rend->init(dpy, vkeyb)) {
+		fprintf(stderr, "failed to initialize the renderer\n");
+		return -1;
+	}
+	rend->resize(width, height);
+
 	// register a passive grab
 	Window root = RootWindow(dpy, DefaultScreen(dpy));
 	XGrabKey(dpy, XKeysymToKeycode(dpy, 'e'), ControlMask, root, False, GrabModeAsync, GrabModeAsync);
 
-	// create texture
-	glGenTextures(1, &frm_tex);
-	glBindTexture(GL_TEXTURE_2D, frm_tex);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	if(!injector.init(dpy)) {
+		return -1;
+	}
+
+	if(num_completions > 0 && !dict.open(words_file)) {
+		fprintf(stderr, "word completion disabled\n");
+	}
+	if(num_predictions > 0) {
+		init_predictions();
+	}
+
+	preview = new TexStream;
+	if(!preview->init()) {
+		fprintf(stderr, "failed to create the preview texture\n");
+		return -1;
+	}
+	// the capture thread downscales the frames to the size of the preview quad
+	motion_params.preview = cv::Size(width * size, height);
 
 	// start the capturing thread
-	if(!start_capture())
+	FrameSource *src = create_frame_source(src_spec, src_pace);
+	if(!src) {
+		fprintf(stderr, "failed to open frame source: %s\n", src_spec);
+		return -1;
+	}
+	if(!start_capture(src))
 		return -1;
 
+	return init_loop();
+}
+
+static int init_loop(void)
+{
+	struct epoll_event ev;
+
+	if((epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		perror("failed to create epoll instance");
+		return -1;
+	}
+	if((timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) == -1) {
+		perror("failed to create the refresh timer");
+		return -1;
+	}
+
+	int fds[] = {ConnectionNumber(dpy), notify_fd, timer_fd};
+	for(int i=0; i<3; i++) {
+		memset(&ev, 0, sizeof ev);
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;	// EV_XSOCK, EV_NOTIFY, EV_TIMER
+		if(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev) == -1) {
+			perror("failed to add an event source to epoll");
+			return -1;
+		}
+	}
 	return 0;
 }
 
+static void process_xevents(void)
+{
+	while(XPending(dpy)) {
+		XEvent xev;
+		XNextEvent(dpy, &xev);
+		handle_event(&xev);
+		loop_stats.x_events++;
+	}
+}
+
+/* any number of published frames collapse into one wakeup and one eventfd
+ * read, and only the newest frame is picked up
+ */
+static void process_frames(void)
+{
+	uint64_t count;
+
+	if(read(notify_fd, &count, sizeof count) != sizeof count) {
+		perror("failed to read frame notifications");
+		return;
+	}
+	unsigned long num = count & (NOTIFY_EOS - 1);
+	loop_stats.notified += num;
+	if(num > 1) {
+		loop_stats.coalesced += num - 1;
+	}
+
+	// only the newest frame matters, older ones were overwritten
+	FrameSlot *slot = frm_mbox.fetch();
+	if(slot) {
+		if(!slot->preview.empty()) {
+			preview->upload(slot->preview);
+		}
+
+		orient = slot->dir;
+		src_offset = (long)slot->msec - (long)slot->grab_msec;
+		cam_motion(orient, slot->msec);
+		must_redraw = true;
+	}
+
+	if(count >= NOTIFY_EOS) {
+		printf("end of capture stream\n");
+		print_motion_stats(stdout, &motion_stats);
+		scroll.print_stats(stdout);
+		injector.print_stats(stdout);
+		rend->print_stats(stdout);
+		preview->print_stats(stdout);
+		print_loop_stats(stdout);
+		orient = 0.0;
+		scroll.reset();
+		must_redraw = true;
+
+		epoll_ctl(epfd, EPOLL_CTL_DEL, notify_fd, 0);
+		close(notify_fd);
+	}
+}
+
+static void refresh_tick(void)
+{
+	uint64_t expired;
+
+	if(read(timer_fd, &expired, sizeof expired) != sizeof expired) {
+		return;
+	}
+	loop_stats.ticks++;
+	loop_stats.missed_ticks += expired - 1;
+
+	// extrapolate the scrolling to the time of this refresh
+	float offs = scroll.advance(src_now());
+	if(offs != 0.0) {
+		vkeyb->move(offs);
+		must_redraw = 1;
+	}
+
+	if(must_redraw) {
+		display();
+		loop_stats.redraws++;
+	} else if(!scroll.scrolling()) {
+		arm_timer(false);
+	}
+}
+
+static void arm_timer(bool arm)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof its);
+	if(arm) {
+		long period = 1000000000 / refresh_rate;
+		// expire right away, so a redraw after a while of idling isn't delayed
+		its.it_value.tv_nsec = 1;
+		its.it_interval.tv_sec = period / 1000000000;
+		its.it_interval.tv_nsec = period % 1000000000;
+	}
+
+	if(timerfd_settime(timer_fd, 0, &its, 0) == -1) {
+		perror("failed to set the refresh timer");
+		return;
+	}
+	timer_armed = arm;
+}
+
+static void print_loop_stats(FILE *fp)
+{
+	fprintf(fp, "main loop: %lu wakeups, %lu X events, %lu redraws\n", loop_stats.wakeups,
+			loop_stats.x_events, loop_stats.redraws);
+	fprintf(fp, "  %lu frames notified, %lu coalesced into newer ones\n", loop_stats.notified,
+			loop_stats.coalesced);
+	fprintf(fp, "  %lu refresh ticks at %g Hz, %lu missed\n", loop_stats.ticks, refresh_rate,
+			loop_stats.missed_ticks);
+}
+
+/* runs from main, and again from atexit */
 void shutdown(void)
 {
+	static bool done;
+
+	if(done) {
+		return;
+	}
+	done = true;
+
+	// the capture thread publishes into frm_mbox and signals notify_fd
+	end_capture();
+
+	delete preview;
+	preview = 0;
+	delete rend;
+	rend = 0;
+	delete vkeyb;
+	vkeyb = 0;
 	glXMakeCurrent(dpy, None, 0);
 	glXDestroyContext(dpy, ctx);
 	XDestroyWindow(dpy, win);
@@ -241,53 +682,38 @@ int create_window(int xsz, int ysz)
 
 void display(void)
 {
+	uint64_t start = get_usec();
+
 	glClearColor(1, 0, 0, 0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
 
-	vkeyb->show();
-	show_frame(0.1);
-
-	glRasterPos2i(-1, -1);
+	rend->draw_strip(vkeyb);
+	rend->draw_preview(preview->texture(), size);
+	if(motion_params.overlay) {
+		rend->draw_overlay(frm_mbox.front_slot(), size);
+	}
 
 	char buf[64];
 	snprintf(buf, sizeof buf, "%f %s", orient, orient > 0 ? "->" : orient < 0 ? "<-" : " ");
-	char *ptr = buf;
-	while(*ptr) {
-		glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *ptr++);
-	}
+	rend->draw_text(0, 0, buf);
 
 	glXSwapBuffers(dpy, win);
+	rend->add_frame_time(get_usec() - start);
 
 	must_redraw = 0;
 	assert(glGetError() == GL_NO_ERROR);
 }
 
-void show_frame(float frm_width)
-{
-	frm_width *= 2;
-
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, frm_tex);
-
-	glBegin(GL_QUADS);
-	glColor3f(1.0, 1.0, 1.0);
-	glTexCoord2f(0, 1); glVertex2f(-1, -1);
-	glTexCoord2f(1, 1); glVertex2f(frm_width - 1, -1);
-	glTexCoord2f(1, 0); glVertex2f(frm_width - 1, 1);
-	glTexCoord2f(0, 0); glVertex2f(-1, 1);
-	glEnd();
-
-	glDisable(GL_TEXTURE_2D);
-}
-
 
 int handle_event(XEvent *xev)
 {
 	static int mapped;
 	KeySym sym;
 
+	if(injector.handle_event(xev)) {
+		return 0;
+	}
+
 	switch(xev->type) {
 	case ConfigureNotify:
 		reshape(xev->xconfigure.width, xev->xconfigure.height);
@@ -302,11 +728,12 @@ int handle_event(XEvent *xev)
 
 	case Expose:
 		if(mapped && xev->xexpose.count == 0) {
-			display();
+			must_redraw = 1;
 		}
 		break;
 
 	case KeyPress:
+		key_mods = xev->xkey.state;
 		sym = XLookupKeysym(&xev->xkey, 0);
 		keyb(sym, 1);
 		break;
@@ -340,6 +767,9 @@ int handle_event(XEvent *xev)
 void reshape(int w, int h)
 {
 	glViewport(0, 0, w, h);
+	if(rend) {
+		rend->resize(w, h);
+	}
 }
 
 void keyb(int key, int pressed)
@@ -353,8 +783,17 @@ void keyb(int key, int pressed)
 		exit(0);
 
 	case 'e':
-		printf("sending key: %c\n", (char)vkeyb->active_key());
-		send_key(vkeyb->active_key());
+		// ctrl of the ctrl-e grab is released around what's typed, so it
+		// doesn't stick to the keys
+		injector.begin_burst(key_mods);
+		if(vkeyb->active_word()) {
+			complete_word(vkeyb->active_word());
+		} else {
+			printf("sending key: %c\n", (char)vkeyb->active_key());
+			send_key(vkeyb->active_key());
+		}
+		injector.end_burst();
+		scroll.selected(src_now());
 		break;
 
 	}
@@ -362,20 +801,86 @@ void keyb(int key, int pressed)
 
 void send_key(KeySym key)
 {
-	Window win;
-	XEvent ev;
-	int junk;
+	injector.type(key);
+	track_word(key);
+	predict_next(key);
+}
+
+/* types the rest of the word and a space */
+void complete_word(const char *word)
+{
+	// word belongs to the completion slots, which change with every key
+	std::string rest = word + typed_word.size();
+
+	for(size_t i=0; i<rest.size(); i++) {
+		send_key(XK_a + rest[i] - 'a');
+	}
+	send_key(XK_space);
+}
+
+/* follows the word being typed and offers its completions in the strip */
+static void track_word(KeySym key)
+{
+	if(key >= XK_a && key <= XK_z) {
+		typed_word += (char)key;
+	} else if(key == XK_BackSpace) {
+		if(!typed_word.empty()) {
+			typed_word.erase(typed_word.size() - 1);
+		}
+	} else {
+		typed_word.clear();
+	}
+
+	if(!dict.is_open()) {
+		return;
+	}
+	if(typed_word.empty()) {
+		completions.clear();
+	} else {
+		dict.complete(typed_word.c_str(), num_completions, &completions);
+	}
+	vkeyb->set_completions(completions);
+	must_redraw = 1;
+}
+
+/* seeds the bigram model from the corpus, learning goes on from what's typed */
+static void init_predictions(void)
+{
+	int char_map[256];
 
-	XGetInputFocus(dpy, &win, &junk);
+	bigrams.init(vkeyb->glyph_count());
 
-	memset(&ev, 0, sizeof ev);
-	ev.type = KeyPress;
-	ev.xkey.window = win;
-	ev.xkey.keycode = XKeysymToKeycode(dpy, key);
-	ev.xkey.state = 0;
-	ev.xkey.time = CurrentTime;
+	for(int i=0; i<256; i++) {
+		char_map[i] = i >= 'a' && i <= 'z' ? vkeyb->find_glyph(XK_a + i - 'a') : -1;
+	}
+	char_map[' '] = vkeyb->find_glyph(XK_space);
 
-	XSendEvent(dpy, InputFocus, False, NoEventMask, &ev);
+	std::vector<int> seq;
+	if(read_text(corpus_file, char_map, &seq)) {
+		bigrams.train(seq);
+	} else {
+		fprintf(stderr, "glyph predictions start untrained\n");
+	}
+}
+
+/* moves the likeliest glyphs to follow key next to it in the strip */
+static void predict_next(KeySym key)
+{
+	if(num_predictions <= 0) {
+		return;
+	}
+
+	int glyph = vkeyb->find_glyph(key);
+	if(glyph < 0) {
+		return;
+	}
+	bigrams.add(prev_glyph, glyph);
+	prev_glyph = glyph;
+
+	std::vector<int> preds;
+	bigrams.predict(glyph, num_predictions, &preds);
+	vkeyb->set_predictions(preds);
+	must_redraw = 1;
 }
 
 static int prev_x = -1;
@@ -392,17 +897,23 @@ void motion(int x, int y)
 	must_redraw = 1;
 }
 
-void cam_motion(double orient)
+/* orient is the motion of a frame captured at msec, which is some time ago by
+ * now; the scroll controller predicts where the hand is going in the meantime
+ */
+void cam_motion(double orient, unsigned long msec)
 {
-	if(orient > 0) {
-		vkeyb->move(1);
-	}
+	scroll.update(orient, msec);
 
-	if(orient < 0) {
-		vkeyb->move(-1);
+	float offs = scroll.advance(src_now());
+	if(offs != 0.0) {
+		vkeyb->move(offs);
+		must_redraw = 1;
 	}
+}
 
-	must_redraw = 1;
+static unsigned long src_now(void)
+{
+	return get_msec() + src_offset;
 }
 
 void button(int x, int y, int bn, int state)
@@ -0,0 +1,478 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "mengine.h"
+#include "motion.h"
+
+#define BLOCK_WIDTH		32
+#define BLOCK_HEIGHT	16
+#define MAX_RANGE		32
+
+const char *motion_engine_names[] = {"lk", "farneback", "block", "mhi", 0};
+
+MotionEngine *create_motion_engine(const char *name, const MotionParams *mp)
+{
+	if(strcmp(name, "lk") == 0) {
+		return new LKEngine(mp);
+	}
+	if(strcmp(name, "farneback") == 0) {
+		return new FarnebackEngine(mp);
+	}
+	if(strcmp(name, "block") == 0) {
+		return new BlockMatchEngine;
+	}
+	if(strcmp(name, "mhi") == 0) {
+		return new MHIEngine;
+	}
+	return 0;
+}
+
+bool is_motion_engine(const char *name)
+{
+	for(int i=0; motion_engine_names[i]; i++) {
+		if(strcmp(name, motion_engine_names[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+MotionEngine::~MotionEngine()
+{
+}
+
+void MotionEngine::configure(const MotionParams *mp)
+{
+}
+
+unsigned long MotionEngine::detections() const
+{
+	return 0;
+}
+
+int MotionEngine::min_width() const
+{
+	return 0;
+}
+
+unsigned int MotionEngine::settings() const
+{
+	return 0;
+}
+
+/* ---- sparse LK ---- */
+
+LKEngine::LKEngine(const MotionParams *mp)
+{
+	pool = 0;
+	if(mp->tiles > 1 && mp->threads != 1) {
+		pool = new ThreadPool(mp->threads);
+	}
+	tracker.pool = pool;
+	configure(mp);
+}
+
+LKEngine::~LKEngine()
+{
+	delete pool;
+}
+
+void LKEngine::configure(const MotionParams *mp)
+{
+	tracker.max_features = mp->num_features;
+	tracker.min_features = mp->num_features / 4;
+	tracker.pyr_levels = mp->pyr_levels;
+	tracker.win_size = mp->win_size;
+	tracker.tiles_x = tracker.tiles_y = mp->tiles > 1 ? mp->tiles : 1;
+}
+
+const char *LKEngine::name() const
+{
+	return "lk";
+}
+
+bool LKEngine::process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec,
+		MotionEstimate *est)
+{
+	est->has_shift = false;
+	return tracker.track(img, est->from, est->to, mask);
+}
+
+void LKEngine::reset()
+{
+	tracker.reset();
+}
+
+unsigned long LKEngine::detections() const
+{
+	return tracker.detections();
+}
+
+unsigned int LKEngine::settings() const
+{
+	return ENGINE_FEATURES | ENGINE_LEVELS;
+}
+
+/* ---- dense Farneback ---- */
+
+FarnebackEngine::FarnebackEngine(const MotionParams *mp)
+{
+	grid_step = 16;
+	configure(mp);
+}
+
+void FarnebackEngine::configure(const MotionParams *mp)
+{
+	levels = mp->pyr_levels;
+	win_size = mp->win_size;
+}
+
+const char *FarnebackEngine::name() const
+{
+	return "farneback";
+}
+
+bool FarnebackEngine::process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec,
+		MotionEstimate *est)
+{
+	est->from.clear();
+	est->to.clear();
+	est->has_shift = false;
+
+	if(prev.empty() || prev.size() != img.size()) {
+		img.copyTo(prev);
+		return false;
+	}
+
+	cv::calcOpticalFlowFarneback(prev, img, flow, 0.5, levels + 1, win_size, 3, 5, 1.1, 0);
+
+	for(int y=grid_step / 2; y<flow.rows; y+=grid_step) {
+		const cv::Point2f *row = flow.ptr<cv::Point2f>(y);
+
+		const unsigned char *mrow = mask.empty() ? 0 : mask.ptr(y);
+
+		for(int x=grid_step / 2; x<flow.cols; x+=grid_step) {
+			if(mrow && !mrow[x]) continue;
+
+			est->from.push_back(cv::Point2f(x, y));
+			est->to.push_back(cv::Point2f(x + row[x].x, y + row[x].y));
+		}
+	}
+
+	img.copyTo(prev);
+	return true;
+}
+
+void FarnebackEngine::reset()
+{
+	prev.release();
+}
+
+unsigned int FarnebackEngine::settings() const
+{
+	return ENGINE_LEVELS;
+}
+
+/* ---- horizontal block matching ---- */
+
+BlockMatchEngine::BlockMatchEngine()
+{
+	decimate = 4;
+	range = 12;
+	min_diff = 2.0;
+	min_gain = 0.7;
+}
+
+const char *BlockMatchEngine::name() const
+{
+	return "block";
+}
+
+bool BlockMatchEngine::process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec,
+		MotionEstimate *est)
+{
+	est->from.clear();
+	est->to.clear();
+	est->shift = cv::Point2f(0, 0);
+	est->confidence = 0.0;
+	est->has_shift = true;
+
+	cv::resize(img, small, cv::Size(img.cols / decimate, img.rows / decimate), 0, 0, CV_INTER_AREA);
+
+	if(prev.empty() || prev.size() != small.size()) {
+		small.copyTo(prev);
+		return false;
+	}
+
+	/* the configured range stays as it is for later frames */
+	int search = std::min(std::max(range, 0), MAX_RANGE);
+	if(small.cols < BLOCK_WIDTH + 2 * search || small.rows < BLOCK_HEIGHT) {
+		/* no block fits: no estimate, rather than a zero displacement */
+		est->has_shift = false;
+		cv::swap(prev, small);
+		return false;
+	}
+
+	int num_blocks = 0;
+	moved.clear();
+	for(int by=0; by + BLOCK_HEIGHT <= small.rows; by+=BLOCK_HEIGHT) {
+		/* blocks are in or out of the mask by their centre */
+		const unsigned char *mrow = mask.empty() ? 0 :
+			mask.ptr((by + BLOCK_HEIGHT / 2) * img.rows / small.rows);
+
+		for(int bx=search; bx + BLOCK_WIDTH + search <= small.cols; bx+=BLOCK_WIDTH) {
+			if(mrow && !mrow[(bx + BLOCK_WIDTH / 2) * img.cols / small.cols]) continue;
+
+			unsigned int sad0;
+			float dx = match_block(bx, by, search, &sad0);
+			num_blocks++;
+
+			if(dx != 0.0 && sad0 >= min_diff * BLOCK_WIDTH * BLOCK_HEIGHT) {
+				moved.push_back(dx);
+			}
+		}
+	}
+
+	if(!moved.empty()) {
+		size_t mid = moved.size() / 2;
+		std::nth_element(moved.begin(), moved.begin() + mid, moved.end());
+
+		float med = moved[mid];
+		est->shift.x = med * img.cols / small.cols;
+
+		/* agreement of the moving blocks with the median */
+		int agree = 0;
+		for(size_t i=0; i<moved.size(); i++) {
+			if(fabs(moved[i] - med) <= 1.0) agree++;
+		}
+		est->confidence = (float)agree / moved.size();
+	} else if(num_blocks) {
+		est->confidence = 1.0;	/* every block was compared, none moved */
+	}
+
+	cv::swap(prev, small);
+	return true;
+}
+
+/* returns the sub-pixel horizontal displacement of the block at bx, by since
+ * the previous frame, searched within range pixels either way, or 0 if the
+ * best match isn't significantly better than no displacement
+ */
+float BlockMatchEngine::match_block(int bx, int by, int range, unsigned int *sad0) const
+{
+	int nshifts = range * 2 + 1;
+	unsigned int sad[MAX_RANGE * 2 + 1];
+
+	for(int i=0; i<nshifts; i++) {
+		int dx = i - range;
+		unsigned int sum = 0;
+
+		/* content which moved right by dx is found dx pixels to the left
+		 * in the previous frame
+		 */
+		for(int y=by; y<by + BLOCK_HEIGHT; y++) {
+			const unsigned char *cur = small.ptr(y) + bx;
+			const unsigned char *old = prev.ptr(y) + bx - dx;
+#ifdef __SSE2__
+			__m128i a0 = _mm_loadu_si128((const __m128i*)cur);
+			__m128i a1 = _mm_loadu_si128((const __m128i*)(cur + 16));
+			__m128i b0 = _mm_loadu_si128((const __m128i*)old);
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(old + 16));
+			__m128i s = _mm_add_epi64(_mm_sad_epu8(a0, b0), _mm_sad_epu8(a1, b1));
+			sum += _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+#else
+			for(int x=0; x<BLOCK_WIDTH; x++) {
+				sum += abs((int)cur[x] - (int)old[x]);
+			}
+#endif
+		}
+
+		sad[i] = sum;
+	}
+	*sad0 = sad[range];
+
+	/* ties go to the smallest displacement */
+	int best = range;
+	for(int i=0; i<nshifts; i++) {
+		if(sad[i] < sad[best] || (sad[i] == sad[best] && abs(i - range) < abs(best - range))) {
+			best = i;
+		}
+	}
+
+	if(best == range || sad[best] > min_gain * sad[range]) {
+		return 0.0;
+	}
+
+	/* parabola through the minimum and its neighbours */
+	float offs = 0.0;
+	if(best > 0 && best < nshifts - 1) {
+		float l = sad[best - 1], c = sad[best], r = sad[best + 1];
+		float denom = l - 2.0 * c + r;
+		if(denom > 0.0) {
+			offs = 0.5 * (l - r) / denom;
+		}
+	}
+	return best - range + offs;
+}
+
+void BlockMatchEngine::reset()
+{
+	prev.release();
+}
+
+int BlockMatchEngine::min_width() const
+{
+	return (BLOCK_WIDTH + 2 * std::min(std::max(range, 0), MAX_RANGE)) * decimate;
+}
+
+/* ---- motion history ---- */
+
+MHIEngine::MHIEngine()
+{
+	duration = 1.0;
+	recent = 0.5;
+	/* over a 3x3 aperture, a silhouette edge moving a pixel or more per frame
+	 * spans one frame interval, and one moving a quarter pixel spans eight
+	 */
+	min_delta = 0.5;
+	max_delta = 8.0;
+	diff_thres = 30;
+	min_area = 64;
+	start_msec = prev_msec = 0;
+	frame_sec = 0.0;
+	prev_ctr_valid = false;
+}
+
+const char *MHIEngine::name() const
+{
+	return "mhi";
+}
+
+bool MHIEngine::process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec,
+		MotionEstimate *est)
+{
+	est->from.clear();
+	est->to.clear();
+	est->shift = cv::Point2f(0, 0);
+	est->confidence = 0.0;
+	est->has_shift = true;
+
+	if(prev.empty() || prev.size() != img.size()) {
+		reset();
+		img.copyTo(prev);
+		mhi = cv::Mat::zeros(img.size(), CV_32FC1);
+		start_msec = prev_msec = msec;
+		return false;
+	}
+
+	/* timestamps in seconds since the first frame, to keep float precision */
+	float t = (msec - start_msec) / 1000.0;
+
+	if(msec > prev_msec) {
+		float dt = (msec - prev_msec) / 1000.0;
+		frame_sec = frame_sec > 0.0 ? frame_sec + 0.1 * (dt - frame_sec) : dt;
+	}
+	prev_msec = msec;
+
+	cv::absdiff(img, prev, sil);
+	cv::threshold(sil, sil, diff_thres, 1, CV_THRESH_BINARY);
+	if(!mask.empty()) {
+		cv::bitwise_and(sil, mask, sil);
+	}
+	cv::updateMotionHistory(sil, mhi, t, duration);
+	img.copyTo(prev);
+
+	/* bounding box of the recent motion, and centroid of the latest */
+	float oldest = t - recent;
+	int x0 = mhi.cols, y0 = mhi.rows, x1 = -1, y1 = -1;
+	double sx = 0.0, sy = 0.0;
+	int area = 0, npix = 0;
+
+	for(int y=0; y<mhi.rows; y++) {
+		const float *hrow = mhi.ptr<float>(y);
+		const unsigned char *srow = sil.ptr(y);
+
+		for(int x=0; x<mhi.cols; x++) {
+			if(hrow[x] < oldest || hrow[x] <= 0.0) continue;
+
+			if(x < x0) x0 = x;
+			if(x > x1) x1 = x;
+			if(y < y0) y0 = y;
+			if(y > y1) y1 = y;
+			area++;
+
+			if(srow[x]) {
+				sx += x;
+				sy += y;
+				npix++;
+			}
+		}
+	}
+
+	if(area < min_area || npix < min_area) {
+		prev_ctr_valid = false;
+		return true;
+	}
+
+	cv::Point2f ctr(sx / npix, sy / npix);
+	cv::Point2f disp = ctr - prev_ctr;
+	bool have_disp = prev_ctr_valid;
+	prev_ctr = ctr;
+	prev_ctr_valid = true;
+	if(!have_disp) {
+		return true;
+	}
+
+	if(frame_sec <= 0.0) {
+		return true;
+	}
+	cv::calcMotionGradient(mhi, grad_mask, orient, min_delta * frame_sec, max_delta * frame_sec, 3);
+
+	cv::Rect roi(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+	if(!cv::countNonZero(grad_mask(roi))) {
+		return true;	/* no usable gradient, the orientation would read 0 */
+	}
+	double angle = cv::calcGlobalOrientation(orient(roi), grad_mask(roi), mhi(roi), t, duration);
+
+	float dx = cos(angle * CV_PI / 180.0);
+	float dy = sin(angle * CV_PI / 180.0);
+	float speed = disp.x * dx + disp.y * dy;
+
+	/* the silhouette must move along the history gradient */
+	if(speed > 0.0) {
+		est->shift = cv::Point2f(dx * speed, dy * speed);
+		/* how well the silhouette displacement agrees with the orientation */
+		est->confidence = std::min(speed / (float)hypot(disp.x, disp.y), 1.0f);
+	}
+	return true;
+}
+
+void MHIEngine::reset()
+{
+	prev.release();
+	mhi.release();
+	frame_sec = 0.0;
+	prev_ctr_valid = false;
+}
@@ -0,0 +1,170 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MENGINE_H_
+#define MENGINE_H_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "tracker.h"
+
+struct MotionParams;
+
+/* motion parameters an engine's cost depends on, besides the image size */
+enum {
+	ENGINE_FEATURES	= 1,	/* num_features */
+	ENGINE_LEVELS	= 2		/* pyr_levels */
+};
+
+/* output of a motion engine, in the coordinates of the image it was given */
+struct MotionEstimate {
+	/* sparse motion vectors, for engines which produce them */
+	std::vector<cv::Point2f> from, to;
+	/* global translation, for engines which estimate it directly */
+	cv::Point2f shift;
+	float confidence;	/* of the translation, in [0, 1] */
+	bool has_shift;
+};
+
+class MotionEngine {
+public:
+	virtual ~MotionEngine();
+
+	virtual const char *name() const = 0;
+
+	/* estimates the motion from the previous frame to img. If mask isn't
+	 * empty, only the parts of img where it's non-zero are considered.
+	 * Returns false if there is nothing to compare against yet (first frame,
+	 * size change), or the image is too small for the engine; there is no
+	 * estimate then.
+	 */
+	virtual bool process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec,
+			MotionEstimate *est) = 0;
+	virtual void reset() = 0;
+	/* applies changed parameters. Callers reset the engine if the image size
+	 * or pyramid levels change.
+	 */
+	virtual void configure(const MotionParams *mp);
+
+	/* feature detection runs, for engines which detect features */
+	virtual unsigned long detections() const;
+	/* narrowest image the engine can estimate anything on, 0 if any will do */
+	virtual int min_width() const;
+	/* ENGINE_* flags of the parameters the engine uses */
+	virtual unsigned int settings() const;
+};
+
+/* Shi-Tomasi corners tracked with sparse pyramidal LK, optionally tiled
+ * across a thread pool
+ */
+class LKEngine : public MotionEngine {
+private:
+	FeatureTracker tracker;
+	ThreadPool *pool;
+
+public:
+	LKEngine(const MotionParams *mp);
+	~LKEngine();
+
+	const char *name() const;
+	bool process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec, MotionEstimate *est);
+	void reset();
+	void configure(const MotionParams *mp);
+	unsigned long detections() const;
+	unsigned int settings() const;
+};
+
+/* dense Farneback optical flow, sampled on a regular grid */
+class FarnebackEngine : public MotionEngine {
+private:
+	cv::Mat prev, flow;
+
+public:
+	int grid_step;		/* sample spacing of the flow field */
+	int levels, win_size;
+
+	FarnebackEngine(const MotionParams *mp);
+
+	const char *name() const;
+	bool process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec, MotionEstimate *est);
+	void reset();
+	void configure(const MotionParams *mp);
+	unsigned int settings() const;
+};
+
+/* Block matching on a decimated frame, searching horizontal displacements
+ * only. Every block finds its best horizontal match with SSE2 SADs, and the
+ * global translation is the median displacement of the blocks which moved.
+ */
+class BlockMatchEngine : public MotionEngine {
+private:
+	cv::Mat small, prev;
+	std::vector<float> moved;
+
+	float match_block(int bx, int by, int range, unsigned int *sad0) const;
+
+public:
+	int decimate;		/* image decimation factor */
+	int range;			/* search range, decimated pixels either way (max 32) */
+	float min_diff;		/* per pixel difference under which a block is static */
+	float min_gain;		/* best SAD must be below this fraction of the zero-shift SAD */
+
+	BlockMatchEngine();
+
+	const char *name() const;
+	bool process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec, MotionEstimate *est);
+	void reset();
+	/* one block and its search range, before decimation */
+	int min_width() const;
+};
+
+/* Motion history image. Frame differences are stamped into a persistent
+ * history buffer with their source timestamp, and the direction is the global
+ * orientation of the history gradient over the region which moved recently.
+ * The speed is the displacement of the silhouette along that direction. The
+ * gradient limits are in frames, and scale with the measured frame interval.
+ */
+class MHIEngine : public MotionEngine {
+private:
+	cv::Mat prev, sil, mhi, grad_mask, orient;
+	unsigned long start_msec, prev_msec;
+	float frame_sec;		/* running average of the frame interval */
+	cv::Point2f prev_ctr;
+	bool prev_ctr_valid;
+
+public:
+	float duration;		/* seconds a silhouette stays in the history */
+	float recent;		/* seconds of history the orientation is computed over */
+	float min_delta, max_delta;	/* gradient limits, frame intervals per pixel */
+	int diff_thres;		/* frame difference counted as motion */
+	int min_area;		/* pixels of recent motion below which nothing moved */
+
+	MHIEngine();
+
+	const char *name() const;
+	bool process(const cv::Mat &img, const cv::Mat &mask, unsigned long msec, MotionEstimate *est);
+	void reset();
+};
+
+/* names: "lk", "farneback", "block", "mhi". Returns null for unknown names. */
+MotionEngine *create_motion_engine(const char *name, const MotionParams *mp);
+/* null terminated list of the engine names */
+extern const char *motion_engine_names[];
+bool is_motion_engine(const char *name);
+
+#endif	/* MENGINE_H_ */
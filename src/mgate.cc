@@ -0,0 +1,168 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "mgate.h"
+
+/* weight of the latest gated frame in the noise estimate */
+#define NOISE_ADAPT		0.05f
+/* the noise floor moves up by FLOOR_TAU and down by 1 - FLOOR_TAU of
+ * FLOOR_ADAPT of the difference from each frame
+ */
+#define FLOOR_TAU		0.2f
+#define FLOOR_ADAPT		0.02f
+/* only differences under FLOOR_RANGE times the threshold move the floor */
+#define FLOOR_RANGE		2.0f
+
+MotionGate::MotionGate()
+{
+	decimate = 4;
+	k = 4.0;
+	min_thres = 1.5;
+	warmup = 8;
+
+	num_frames = num_gated = 0;
+	reset();
+}
+
+void MotionGate::reset()
+{
+	have_ref = false;
+	noise_mean = noise_var = 0.0;
+	noise_floor = -1.0;
+	num_samples = 0;
+	last_diff = 0.0;
+}
+
+bool MotionGate::check(const cv::Mat &gray)
+{
+	int xsz = gray.cols / decimate;
+	int ysz = gray.rows / decimate;
+
+	num_frames++;
+
+	small.create(ysz, xsz, CV_8UC1);
+	for(int i=0; i<ysz; i++) {
+		const unsigned char *src = gray.ptr(i * decimate);
+		unsigned char *dest = small.ptr(i);
+
+		for(int j=0; j<xsz; j++) {
+			dest[j] = src[j * decimate];
+		}
+	}
+
+	if(!have_ref || ref.size() != small.size()) {
+		small.copyTo(ref);
+		have_ref = true;
+		return true;
+	}
+
+	last_diff = mean_abs_diff();
+
+	/* clear motion says nothing about the noise, and would otherwise drag
+	 * the floor, and the threshold after it, up during a long gesture. The
+	 * price is that a noise jump over FLOOR_RANGE times the threshold is
+	 * never absorbed, and every frame goes through until the next reset.
+	 */
+	if(last_diff < FLOOR_RANGE * threshold()) {
+		if(noise_floor < 0.0) {
+			noise_floor = last_diff;
+		} else {
+			float w = last_diff > noise_floor ? FLOOR_TAU : 1.0 - FLOOR_TAU;
+			noise_floor += FLOOR_ADAPT * w * (last_diff - noise_floor);
+		}
+	}
+
+	if(num_samples >= warmup && last_diff <= threshold()) {
+		float delta = last_diff - noise_mean;
+		noise_mean += NOISE_ADAPT * delta;
+		noise_var = (1.0 - NOISE_ADAPT) * (noise_var + NOISE_ADAPT * delta * delta);
+
+		num_gated++;
+		return false;
+	}
+
+	if(num_samples < warmup) {
+		/* bootstrap the noise estimate with a plain running mean/variance */
+		float delta = last_diff - noise_mean;
+		num_samples++;
+		noise_mean += delta / num_samples;
+		noise_var += (delta * (last_diff - noise_mean) - noise_var) / num_samples;
+	} else if(noise_floor > noise_mean) {
+		/* nothing gated although the floor rose: the noise level went up */
+		noise_mean += NOISE_ADAPT * (noise_floor - noise_mean);
+	}
+
+	/* the reference is the last frame motion analysis saw, so that slow
+	 * motion accumulates until it gets through
+	 */
+	cv::swap(ref, small);
+	return true;
+}
+
+float MotionGate::mean_abs_diff() const
+{
+	unsigned long sum = 0;
+	int xsz = small.cols;
+
+	for(int i=0; i<small.rows; i++) {
+		const unsigned char *a = small.ptr(i);
+		const unsigned char *b = ref.ptr(i);
+		int j = 0;
+
+#ifdef __SSE2__
+		__m128i acc = _mm_setzero_si128();
+		for(; j<=xsz - 16; j+=16) {
+			__m128i va = _mm_loadu_si128((const __m128i*)(a + j));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+			/* two 16bit partial sums, in the low words of each qword */
+			acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+		}
+		sum += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+		for(; j<xsz; j++) {
+			sum += abs((int)a[j] - (int)b[j]);
+		}
+	}
+	return (float)sum / (small.cols * small.rows);
+}
+
+float MotionGate::threshold() const
+{
+	float thres = noise_mean + k * sqrt(noise_var);
+	return thres > min_thres ? thres : min_thres;
+}
+
+float MotionGate::difference() const
+{
+	return last_diff;
+}
+
+unsigned long MotionGate::frames() const
+{
+	return num_frames;
+}
+
+unsigned long MotionGate::gated() const
+{
+	return num_gated;
+}
@@ -0,0 +1,63 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MGATE_H_
+#define MGATE_H_
+
+#include <opencv2/opencv.hpp>
+
+/* Cheap pre-filter in front of motion analysis: compares a decimated copy of
+ * each frame against the last frame which was let through, and gates the
+ * frame out when the mean absolute difference is within the noise level of
+ * the camera. The noise level is estimated continuously from gated frames,
+ * and pulled up towards a slowly tracked lower expectile of the difference
+ * of the frames near the threshold, so that it can also rise when nothing
+ * gets gated any more (auto-gain, lighting changes). Frames well over the
+ * threshold are taken as motion and don't move the floor.
+ */
+class MotionGate {
+private:
+	cv::Mat small, ref;		/* decimated current and reference frames */
+	bool have_ref;
+	float noise_mean, noise_var;
+	float noise_floor;		/* lower expectile of the difference near the threshold */
+	int num_samples;		/* noise samples taken during warmup */
+	float last_diff;
+	unsigned long num_frames, num_gated;
+
+	float mean_abs_diff() const;
+
+public:
+	int decimate;			/* sample every decimate-th pixel in each direction */
+	float k;				/* let through frames over noise mean + k sigma */
+	float min_thres;		/* lower bound of the threshold, in gray levels */
+	int warmup;				/* frames let through while estimating the noise */
+
+	MotionGate();
+
+	/* returns true if the frame should go through motion analysis */
+	bool check(const cv::Mat &gray);
+	void reset();
+
+	float threshold() const;
+	float difference() const;	/* mean absolute difference of the last frame */
+	unsigned long frames() const;
+	unsigned long gated() const;
+};
+
+#endif	/* MGATE_H_ */
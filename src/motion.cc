@@ -17,171 +17,662 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
 #include <stdio.h>
-#include <sys/time.h>
+#include <string.h>
+#include <algorithm>
 #include "motion.h"
-
-#define NUM_FEATURES 400
-#define MHI_DURATION 1000
-#define OFFSET 30
-
-static unsigned long get_msec();
-
-bool stop_capture = false;
-int pipefd[2];
-cv::Mat frm;
+#include "timer.h"
+#include "spscq.h"
+#include "preproc.h"
+
+/* tracks which moved less than this, in frame pixels, are static background */
+#define MIN_TRACK_LEN		1.0f
+/* fewer moving tracks than this means nothing moved */
+#define MIN_MOVING_TRACKS	4
+#define OUTLIER_SIGMAS		3.0f
+/* outlier rejection limit when the tracks agree perfectly, in frame pixels */
+#define MIN_OUTLIER_LIMIT	0.5f
+
+static cv::Mat motion_input(MotionContext *ctx, const cv::Mat &frm8b);
+
+MotionParams motion_params = {
+	"lk",	/* engine */
+	150,	/* num_features */
+	3,		/* pyr_levels */
+	21,		/* win_size */
+	1.0,	/* proc_scale */
+	cv::Rect_<float>(0, 0, 1, 1),	/* roi */
+	DROP_STALE,	/* drop */
+	true,	/* gate */
+	true,	/* overlay */
+	30.0,	/* frame_budget */
+	false,	/* segment */
+	1,		/* tiles */
+	0,		/* threads */
+	0,		/* record */
+	cv::Size(0, 0)	/* preview */
+};
+
+std::atomic<bool> stop_capture(false);
+int notify_fd = -1;
+FrameMailbox frm_mbox;
 pthread_t ptd;
+static bool capture_started;
+MotionStats motion_stats;
+void (*motion_frame_cb)(const FramePacket *pkt);
 
-bool start_capture()
+bool start_capture(FrameSource *src)
 {
-	if(pipe(pipefd) == -1) {
-		perror("failed to create synchronization pipe");
+	/* if the reader falls behind, notifications add up instead of queueing */
+	if((notify_fd = eventfd(0, EFD_CLOEXEC)) == -1) {
+		perror("failed to create notification eventfd");
 		return false;
 	}
 
-	int res = pthread_create(&ptd, 0, capture_thread, 0);
+	int res = pthread_create(&ptd, 0, capture_thread, src);
 	if(res != 0) {
 		fprintf(stderr, "Failed to create capturing thread: %s\n", strerror(res));
+		close(notify_fd);
 		return false;
 	}
+	capture_started = true;
 	return true;
 }
 
+void end_capture(void)
+{
+	if(capture_started) {
+		stop_capture = true;
+		pthread_join(ptd, 0);
+		capture_started = false;
+	}
+}
+
+/* ---- capture pipeline ----
+ * grab -> prep -> flow -> publish, each stage on its own thread, connected
+ * by SPSC queues. A fixed pool of packets circulates through the stages and
+ * returns from publish to grab through the free queue, so at most
+ * PIPE_PACKETS frames are in flight.
+ */
+#define PIPE_PACKETS	6
+
+struct Pipeline {
+	FrameSource *src;
+	FramePacket pkt[PIPE_PACKETS];
+	SPSCQueue<FramePacket*> freeq, prepq, flowq, pubq;
+
+	Pipeline() : freeq(PIPE_PACKETS), prepq(PIPE_PACKETS),
+		flowq(PIPE_PACKETS), pubq(PIPE_PACKETS) {}
+};
+
+static void *grab_stage(void *arg);
+static void *prep_stage(void *arg);
+static void *flow_stage(void *arg);
+static FramePacket *get_packet(SPSCQueue<FramePacket*> *q);
+static void set_overlay(FrameSlot *slot, const MotionResult *res);
+static void make_preview(FrameSlot *slot, cv::Mat &scratch);
+static void record_frame(RecWriter *rec, const FramePacket *pkt, unsigned long seq);
+static void notify(uint64_t val);
+
 void *capture_thread(void *arg)
 {
-	cv::VideoCapture cap(0);
-	if(!cap.isOpened()) {
-		fprintf(stderr, "failed to open video capture device\n");
+	Pipeline *pl = new Pipeline;
+	RecWriter rec;
+	const char *rec_file = motion_params.record;
+	pthread_t prep_td, flow_td, grab_td;
+	cv::Mat preview_scratch;
+	FramePacket *pkt;
+	unsigned long seq = 0;
+	uint64_t first_grab = 0;
+	int res;
+
+	pl->src = (FrameSource*)arg;
+	for(int i=0; i<PIPE_PACKETS; i++) {
+		pl->freeq.push(pl->pkt + i);
 	}
+	memset(&motion_stats, 0, sizeof motion_stats);
 
-	cv::Mat next_frm, prev_frm, frm8b, prev_frm8b, colimg;
+	if((res = pthread_create(&prep_td, 0, prep_stage, pl)) != 0) {
+		fprintf(stderr, "failed to create preprocessing thread: %s\n", strerror(res));
+		goto done;
+	}
+	if((res = pthread_create(&flow_td, 0, flow_stage, pl)) != 0) {
+		fprintf(stderr, "failed to create motion analysis thread: %s\n", strerror(res));
+		pl->freeq.pop(&pkt);
+		pkt->eos = true;
+		pl->prepq.push(pkt);
+		pthread_join(prep_td, 0);
+		goto done;
+	}
+	if((res = pthread_create(&grab_td, 0, grab_stage, pl)) != 0) {
+		fprintf(stderr, "failed to create frame grabbing thread: %s\n", strerror(res));
+		pl->freeq.pop(&pkt);
+		pkt->eos = true;
+		pl->prepq.push(pkt);
+	}
 
-	cap >> next_frm;
-	cv::flip(next_frm, next_frm, 1);
-	colimg = next_frm.clone();
-	cv::cvtColor(next_frm, next_frm, CV_RGB2GRAY);
-	next_frm.convertTo(frm8b, CV_8UC1);
+	/* publish stage: hand the frame and the overlay data to the render loop
+	 * and recycle the packet
+	 */
+	for(;;) {
+		pl->pubq.wait_pop(&pkt);
+		if(pkt->eos) {
+			break;
+		}
+		motion_stats.num_dropped += pkt->discarded;
 
-	while(!stop_capture) {
-		prev_frm = next_frm.clone();
-		prev_frm.convertTo(prev_frm8b, CV_8UC1);
+		if(rec_file && !rec.is_open() && !pkt->raw.empty()) {
+			if(!rec.open(rec_file, pkt->raw.cols, pkt->raw.rows, pkt->raw.type())) {
+				rec_file = 0;
+			}
+		}
 
-		cap >> next_frm;
-		cv::flip(next_frm, next_frm, 1);
-		colimg = next_frm.clone();
-		cv::cvtColor(next_frm, next_frm, CV_RGB2GRAY);
-		next_frm.convertTo(frm8b, CV_8UC1);
+		if(pkt->dropped) {
+			motion_stats.num_dropped++;
+			if(rec.is_open()) {
+				record_frame(&rec, pkt, seq);
+			}
+			pl->freeq.push(pkt);
+			continue;
+		}
+		uint64_t t0 = get_usec();
+
+		/* swapping the headers hands the frame over without a copy, and
+		 * gives the packet the slot's old buffer to reuse
+		 */
+		FrameSlot *slot = frm_mbox.back_slot();
+		cv::swap(slot->img, pkt->col);
+		slot->dir = pkt->res.dir;
+		set_overlay(slot, &pkt->res);
+		uint64_t tprev = get_usec();
+		make_preview(slot, preview_scratch);
+		motion_stats.preview_usec += get_usec() - tprev;
+		slot->msec = pkt->msec;
+		slot->grab_msec = pkt->t_grab / 1000;
+		slot->seq = ++seq;
+		frm_mbox.publish();
+		notify(1);
+
+		uint64_t t1 = get_usec();
+		pkt->usec[STAGE_PUBLISH] = t1 - t0;
+		pkt->t_publish = t1;
+
+		if(!first_grab) {
+			first_grab = pkt->t_grab;
+		}
+		motion_stats.num_frames++;
+		if(pkt->res.gated) motion_stats.num_gated++;
+		if(pkt->res.hand.width > 0) motion_stats.num_segmented++;
+		if(pkt->res.dir > 0) motion_stats.num_right++;
+		if(pkt->res.dir < 0) motion_stats.num_left++;
+		if(pkt->has_truth) {
+			motion_stats.num_truth++;
+			if(direction_correct(pkt->res.dir, pkt->truth)) motion_stats.num_correct++;
+		}
+		motion_stats.num_detect = pkt->detections;
+		motion_stats.gov = pkt->gov;
+		for(int i=0; i<NUM_STAGES; i++) {
+			motion_stats.stage_usec[i] += pkt->usec[i];
+		}
+		motion_stats.latency_usec += t1 - pkt->t_grab;
+		motion_stats.wall_usec = t1 - first_grab;
+
+		if(motion_frame_cb) {
+			motion_frame_cb(pkt);
+		}
+		if(rec.is_open()) {
+			record_frame(&rec, pkt, seq);
+		}
 
-		double direction = calculate_motion_dir(frm8b, prev_frm8b, colimg);
-		write(pipefd[1], &direction, sizeof direction);
-		frm = colimg.clone();
+		pl->freeq.push(pkt);
 	}
+
+	if(res == 0) {
+		pthread_join(grab_td, 0);
+	}
+	pthread_join(flow_td, 0);
+	pthread_join(prep_td, 0);
+
+	if(rec.is_open()) {
+		rec.close();
+		motion_stats.num_recorded = rec.frames();
+		motion_stats.num_rec_dropped = rec.dropped();
+	}
+
+done:
+	notify(NOTIFY_EOS);
+	delete pl->src;
+	delete pl;
 	return 0;
 }
 
-double calculate_motion_dir(cv::Mat &frm8b, cv::Mat &prev_frm8b, cv::Mat &colimg)
+static void *grab_stage(void *arg)
 {
-	std::vector<cv::Point2f> prev_corners;
-	std::vector<cv::Point2f> corners;
-	std::vector<unsigned char> status;
-	std::vector<float> err;
+	Pipeline *pl = (Pipeline*)arg;
+	FramePacket *pkt;
+	cv::Mat scratch;
+	unsigned long discarded = 0;
+
+	for(;;) {
+		if(motion_params.drop == DROP_STALE && !pl->freeq.pop(&pkt)) {
+			/* the pipeline is full, keep draining the source so that the
+			 * frames which do make it through are fresh
+			 */
+			if(stop_capture || !pl->src->grab(scratch)) {
+				pl->freeq.wait_pop(&pkt);
+				break;
+			}
+			discarded++;
+			continue;
+		}
+		if(motion_params.drop != DROP_STALE) {
+			pl->freeq.wait_pop(&pkt);
+		}
 
-	cv::goodFeaturesToTrack(prev_frm8b, prev_corners, (float)NUM_FEATURES, 0.01, 3.0);
-	cv::goodFeaturesToTrack(frm8b, corners, (float)NUM_FEATURES, 0.01, 3.0);
-	cv::calcOpticalFlowPyrLK(prev_frm8b, frm8b, prev_corners, corners, status, err);
+		uint64_t t0 = get_usec();
+		if(stop_capture || !pl->src->grab(pkt->raw)) {
+			break;
+		}
+		pkt->t_grab = get_usec();
+		pkt->msec = pl->src->timestamp();
+		pkt->has_truth = pl->src->ground_truth(&pkt->truth);
+		pkt->discarded = discarded;
+		pkt->dropped = pkt->eos = false;
+		for(int i=0; i<NUM_STAGES; i++) {
+			pkt->usec[i] = 0;
+		}
+		pkt->usec[STAGE_GRAB] = pkt->t_grab - t0;
+		discarded = 0;
 
-	cv::Point motion_vector = cv::Point((int)((double)colimg.cols / 2.0), (int)((double)colimg.rows / 2.0));
+		pl->prepq.push(pkt);
+	}
 
-	for(size_t i=0; i<status.size(); i++) {
-		if(!status[i])
-			continue;
+	pkt->eos = true;
+	pl->prepq.push(pkt);
+	return 0;
+}
+
+static void *prep_stage(void *arg)
+{
+	Pipeline *pl = (Pipeline*)arg;
 
-		cv::Point p, q;
-		p.x = prev_corners[i].x;
-		p.y = prev_corners[i].y;
+	for(;;) {
+		FramePacket *pkt = get_packet(&pl->prepq);
 
-		q.x = corners[i].x;
-		q.y = corners[i].y;
+		if(!pkt->eos && !pkt->dropped) {
+			uint64_t t0 = get_usec();
 
-		double angle = atan2((double)(q.y - p.y), (double)(q.x - p.x));
-		double hypotenuse = sqrt(pow((double)(q.y - p.y), 2.0) + pow((double)(q.x - p.x), 2.0));
+			mirror_gray(pkt->raw, pkt->col, pkt->gray);
 
-		p.x = (int)(q.x - hypotenuse * cos(angle));
-		p.y = (int)(q.y - hypotenuse * sin(angle));
+			pkt->usec[STAGE_PREP] = get_usec() - t0;
+		}
 
-		cv::line(colimg, q, p, cv::Scalar(255, 255, 0), 1, CV_AA, 0);
+		pl->flowq.push(pkt);
+		if(pkt->eos) break;
+	}
+	return 0;
+}
 
-		if(hypotenuse > 3) {
-			cv::Point vec2d = cv::Point(q.x - p.x, q.y - p.y);
-			motion_vector = cv::Point(motion_vector.x + vec2d.x, motion_vector.y + vec2d.y);
+static void *flow_stage(void *arg)
+{
+	Pipeline *pl = (Pipeline*)arg;
+	MotionContext ctx;
+	MotionParams *mp = &ctx.params;
+
+	*mp = motion_params;
+	if(!(ctx.engine = create_motion_engine(mp->engine, mp))) {
+		fprintf(stderr, "unknown motion engine: %s, falling back to lk\n", mp->engine);
+		ctx.engine = create_motion_engine("lk", mp);
+	}
+
+	QualityGovernor gov(&motion_params, (unsigned long)(mp->frame_budget * 1000.0));
+
+	for(;;) {
+		FramePacket *pkt = get_packet(&pl->flowq);
+
+		if(!pkt->eos && !pkt->dropped) {
+			uint64_t t0 = get_usec();
+
+			calculate_motion_dir(&ctx, pkt->gray, pkt->msec, &pkt->res);
+
+			pkt->usec[STAGE_FLOW] = get_usec() - t0;
+
+			/* gated frames cost next to nothing and say nothing about the
+			 * settings. Grabbing waits on the source and publishing comes
+			 * later, so the cost of a frame is its preparation and analysis.
+			 */
+			unsigned long usec = pkt->usec[STAGE_PREP] + pkt->usec[STAGE_FLOW];
+			float scale_floor = ctx.roi.width > 0 ?
+				(float)ctx.engine->min_width() / ctx.roi.width : 0.0;
+
+			int levels = mp->pyr_levels;
+			float scale = mp->proc_scale;
+			if(mp->frame_budget > 0.0 && !pkt->res.gated &&
+					gov.update(usec, scale_floor, ctx.engine->settings(), mp)) {
+				if(mp->pyr_levels != levels || mp->proc_scale != scale) {
+					ctx.engine->reset();
+					ctx.gate.reset();
+					ctx.seg.reset();
+				}
+				ctx.engine->configure(mp);
+			}
 		}
+		pkt->detections = ctx.engine->detections();
+		pkt->gov = *gov.stats();
+
+		pl->pubq.push(pkt);
+		if(pkt->eos) break;
+	}
+
+	delete ctx.engine;
+	return 0;
+}
+
+static void notify(uint64_t val)
+{
+	if(write(notify_fd, &val, sizeof val) == -1) {
+		perror("failed to signal notify_fd");
+	}
+}
+
+/* queues the frame and its results to the recording, without blocking */
+static void record_frame(RecWriter *rec, const FramePacket *pkt, unsigned long seq)
+{
+	const MotionResult *res = &pkt->res;
+	RecFrameMeta meta;
+
+	memset(&meta, 0, sizeof meta);
+	meta.msec = pkt->msec;
+	meta.seq = seq;
+	meta.truth = pkt->truth;
+	meta.flags = (pkt->has_truth ? REC_HAS_TRUTH : 0) | (pkt->dropped ? REC_DROPPED : 0);
+
+	if(!pkt->dropped) {
+		meta.dir = res->dir;
+		meta.shift_x = res->shift.x;
+		meta.shift_y = res->shift.y;
+		meta.confidence = res->confidence;
+		meta.flags |= res->gated ? REC_GATED : 0;
+		meta.num_tracks = res->to.size();
+		meta.hand_x = res->hand.x;
+		meta.hand_y = res->hand.y;
+		meta.hand_w = res->hand.width;
+		meta.hand_h = res->hand.height;
+	}
+	meta.detections = pkt->detections;
+	meta.num_features = pkt->gov.num_features;
+	meta.pyr_levels = pkt->gov.pyr_levels;
+	meta.proc_scale = pkt->gov.proc_scale;
+
+	rec->add(pkt->raw, &meta);
+}
+
+/* pops the next packet of a stage. With DROP_STALE, a packet which already
+ * has newer ones queued behind it is marked as dropped, and passes through
+ * the rest of the stages untouched.
+ */
+static FramePacket *get_packet(SPSCQueue<FramePacket*> *q)
+{
+	FramePacket *pkt;
+
+	q->wait_pop(&pkt);
+	if(motion_params.drop == DROP_STALE && !pkt->eos && q->size() > 0) {
+		pkt->dropped = true;
+	}
+	return pkt;
+}
+
+static void set_overlay(FrameSlot *slot, const MotionResult *res)
+{
+	std::vector<cv::Point2f> &flow = slot->flow;
 
-/*
-		q.x = (int)(p.x + cos(angle) + M_PI / 4.0);
-		q.y = (int)(p.y + sin(angle) + M_PI / 4.0);
+	if(!motion_params.overlay) {
+		flow.clear();
+		slot->motion_vec = cv::Point2f(0, 0);
+		slot->hand = cv::Rect();
+		return;
+	}
+
+	flow.resize(res->to.size() * 2);
+	for(size_t i=0; i<res->to.size(); i++) {
+		flow[i * 2] = res->to[i];
+		flow[i * 2 + 1] = res->from[i];
+	}
+
+	slot->motion_vec = res->shift;
+	slot->hand = res->hand;
+}
+
+/* downscales the frame of the slot to the preview size on the capture side,
+ * so the render loop only uploads a few kilobytes per frame
+ */
+static void make_preview(FrameSlot *slot, cv::Mat &scratch)
+{
+	cv::Size sz = motion_params.preview;
+
+	if(sz.width <= 0 || sz.height <= 0) {
+		slot->preview.release();
+		return;
+	}
+	cv::resize(slot->img, scratch, sz, 0, 0, CV_INTER_AREA);
+	cv::cvtColor(scratch, slot->preview, CV_BGR2BGR565);
+}
+
+/* crops the region of interest out of frm8b and downscales it, and records
+ * the mapping back to frame coordinates in ctx
+ */
+static cv::Mat motion_input(MotionContext *ctx, const cv::Mat &frm8b)
+{
+	const cv::Rect_<float> &nroi = ctx->params.roi;
+	cv::Rect roi((int)(nroi.x * frm8b.cols), (int)(nroi.y * frm8b.rows),
+			(int)(nroi.width * frm8b.cols), (int)(nroi.height * frm8b.rows));
+
+	ctx->roi = roi & cv::Rect(0, 0, frm8b.cols, frm8b.rows);
+	if(ctx->roi.width <= 0 || ctx->roi.height <= 0) {
+		ctx->roi = cv::Rect(0, 0, frm8b.cols, frm8b.rows);
+	}
+	cv::Mat sub = frm8b(ctx->roi);
+
+	float scale = ctx->params.proc_scale;
+	if(scale >= 1.0 || scale <= 0.0) {
+		ctx->sx = ctx->sy = 1.0;
+		return sub;
+	}
 
-		cv::line(colimg, q, p, cv::Scalar(0, 0, 255), 1, CV_AA, 0);
+	cv::resize(sub, ctx->proc_frm, cv::Size(), scale, scale, CV_INTER_AREA);
+	ctx->sx = (float)ctx->proc_frm.cols / sub.cols;
+	ctx->sy = (float)ctx->proc_frm.rows / sub.rows;
+	return ctx->proc_frm;
+}
 
-		q.x = (int)(p.x + cos(angle) - M_PI / 4.0);
-		q.y = (int)(p.y + sin(angle) - M_PI / 4.0);
+double calculate_motion_dir(MotionContext *ctx, const cv::Mat &frm8b, unsigned long msec,
+		MotionResult *res)
+{
+	MotionEstimate *est = &ctx->est;
+	std::vector<cv::Point2f> &prev_corners = res->from;
+	std::vector<cv::Point2f> &corners = res->to;
+
+	cv::Mat input = motion_input(ctx, frm8b);
+
+	res->gated = ctx->params.gate && !ctx->gate.check(input);
+	if(res->gated) {
+		prev_corners.clear();
+		corners.clear();
+		res->shift = cv::Point2f(0, 0);
+		res->confidence = 1.0;
+		res->hand = cv::Rect();
+		res->dir = 0.0;
+		return 0.0;
+	}
 
-		cv::line(colimg, q, p, cv::Scalar(255, 0, 0), 1, CV_AA, 0);*/
+	cv::Mat mask;
+	res->hand = cv::Rect();
+	if(ctx->params.segment && ctx->seg.segment(input)) {
+		mask = ctx->seg.mask();
 
+		cv::Rect w = ctx->seg.window();
+		res->hand = cv::Rect((int)(w.x / ctx->sx) + ctx->roi.x, (int)(w.y / ctx->sy) + ctx->roi.y,
+				(int)(w.width / ctx->sx), (int)(w.height / ctx->sy));
 	}
 
-	cv::Point ctr = cv::Point((int)((double)colimg.cols / 2.0), (int)((double)colimg.rows / 2.0));
-	cv::Point xproj = cv::Point(motion_vector.x, ctr.y);
+	if(!ctx->engine->process(input, mask, msec, est)) {
+		prev_corners.clear();
+		corners.clear();
+		res->shift = cv::Point2f(0, 0);
+		res->confidence = 0.0;
+		res->dir = 0.0;
+		return 0.0;
+	}
+	prev_corners.swap(est->from);
+	corners.swap(est->to);
+
+	/* map the tracks back to full frame coordinates */
+	for(size_t i=0; i<corners.size(); i++) {
+		prev_corners[i].x = prev_corners[i].x / ctx->sx + ctx->roi.x;
+		prev_corners[i].y = prev_corners[i].y / ctx->sy + ctx->roi.y;
+		corners[i].x = corners[i].x / ctx->sx + ctx->roi.x;
+		corners[i].y = corners[i].y / ctx->sy + ctx->roi.y;
+	}
 
-	cv::line(colimg, motion_vector, ctr, cv::Scalar(255, 0, 0), 3, CV_AA, 0);
-	cv::line(colimg, xproj, ctr, cv::Scalar(0, 0, 255), 3, CV_AA, 0);
+	if(est->has_shift) {
+		/* the engine estimated the global translation itself */
+		res->shift = cv::Point2f(est->shift.x / ctx->sx, est->shift.y / ctx->sy);
+		res->confidence = est->confidence;
+	} else {
+		res->confidence = estimate_translation(ctx, prev_corners, corners, MIN_TRACK_LEN,
+				&res->shift);
+	}
 
-	return (xproj.x - ctr.x);
+	res->dir = res->shift.x;
+	return res->dir;
 }
 
-double calculate_orientation(cv::Mat &frm, cv::Mat &prev_frm)
+float estimate_translation(MotionContext *ctx, const std::vector<cv::Point2f> &from,
+		const std::vector<cv::Point2f> &to, float min_len, cv::Point2f *shift)
 {
-	cv::Mat silhouette;
-	cv::absdiff(frm, prev_frm, silhouette);
+	std::vector<float> &dx = ctx->dx;
+	std::vector<float> &dy = ctx->dy;
 
-	cv::Mat sil8;
-	cv::cvtColor(silhouette, silhouette, CV_RGB2GRAY);
-	silhouette.convertTo(sil8, CV_8UC1);
+	*shift = cv::Point2f(0, 0);
 
-	double max_val, min_val;
-	cv::minMaxLoc(sil8, &min_val, &max_val);
+	dx.clear();
+	dy.clear();
+	for(size_t i=0; i<to.size(); i++) {
+		float x = to[i].x - from[i].x;
+		float y = to[i].y - from[i].y;
 
-	cv::threshold(sil8, sil8, 119, max_val, CV_THRESH_BINARY);
+		if(x * x + y * y >= min_len * min_len) {
+			dx.push_back(x);
+			dy.push_back(y);
+		}
+	}
 
-	cv::Mat mhi;
-	sil8.convertTo(mhi, CV_32FC1, 1.0 / (float)UCHAR_MAX);
+	int num = dx.size();
+	if(num < MIN_MOVING_TRACKS) {
+		return to.empty() ? 0.0 : 1.0 - (float)num / to.size();
+	}
 
-	cv::Mat mask = cv::Mat(mhi.size().width, mhi.size().height, CV_8UC1);
-	cv::Mat orientation = mhi.clone();
+	/* median and median absolute deviation of each component, on copies
+	 * since nth_element reorders
+	 */
+	size_t mid = num / 2;
+	float med[2], lim[2];
+	std::vector<float> *comp[2] = {&dx, &dy};
+
+	for(int c=0; c<2; c++) {
+		std::vector<float> &v = ctx->scratch;
+		v = *comp[c];
+		std::nth_element(v.begin(), v.begin() + mid, v.end());
+		med[c] = v[mid];
+
+		for(int i=0; i<num; i++) {
+			v[i] = fabs(v[i] - med[c]);
+		}
+		std::nth_element(v.begin(), v.begin() + mid, v.end());
+		/* 1.4826 MAD estimates the standard deviation of normal noise */
+		lim[c] = std::max(OUTLIER_SIGMAS * 1.4826f * v[mid], MIN_OUTLIER_LIMIT);
+	}
 
-	double duration = MHI_DURATION;
-	unsigned long timestamp = get_msec() + duration;
+	/* mean of the inliers */
+	float sx = 0.0, sy = 0.0;
+	int inliers = 0;
+	for(int i=0; i<num; i++) {
+		if(fabs(dx[i] - med[0]) <= lim[0] && fabs(dy[i] - med[1]) <= lim[1]) {
+			sx += dx[i];
+			sy += dy[i];
+			inliers++;
+		}
+	}
+	*shift = cv::Point2f(sx / inliers, sy / inliers);
 
-	double min_delta = abs(timestamp);
-	double max_delta = abs(timestamp) + 500.0;
+	float conf = (float)inliers / num;
+	if(inliers < MIN_MOVING_TRACKS * 2) {
+		conf *= (float)inliers / (MIN_MOVING_TRACKS * 2);
+	}
+	return conf;
+}
 
-	cv::updateMotionHistory(sil8, mhi, timestamp, duration);
-	cv::calcMotionGradient(mhi, mask, orientation, min_delta, max_delta, 3);
+void print_motion_stats(FILE *fp, const MotionStats *st)
+{
+	static const char *stage_name[] = {"grab", "prep", "flow", "publish"};
 
-	double global_orientation = cv::calcGlobalOrientation(orientation, mask, mhi, timestamp, duration);
+	if(!st->num_frames || !st->wall_usec) {
+		fprintf(fp, "no frames processed\n");
+		return;
+	}
 
-	return global_orientation;
+	fprintf(fp, "frames: %lu (%lu dropped)\n", st->num_frames, st->num_dropped);
+	fprintf(fp, "throughput: %.2f fps\n", st->num_frames * 1000000.0 / st->wall_usec);
+	fprintf(fp, "latency: %.3f ms grab to publish\n", st->latency_usec / 1000.0 / st->num_frames);
+	for(int i=0; i<NUM_STAGES; i++) {
+		fprintf(fp, "  %-8s %.3f ms/frame\n", stage_name[i],
+				st->stage_usec[i] / 1000.0 / st->num_frames);
+	}
+	if(st->preview_usec) {
+		fprintf(fp, "  (preview downscaling %.3f ms/frame)\n", st->preview_usec / 1000.0 / st->num_frames);
+	}
+	fprintf(fp, "direction: %lu right, %lu left, %lu none\n", st->num_right, st->num_left,
+			st->num_frames - st->num_right - st->num_left);
+	if(st->num_truth) {
+		fprintf(fp, "direction accuracy: %.1f%% of %lu frames with known motion\n",
+				100.0 * st->num_correct / st->num_truth, st->num_truth);
+	}
+	fprintf(fp, "static scene gate: %lu frames (%.1f%%) skipped motion analysis\n",
+			st->num_gated, 100.0 * st->num_gated / st->num_frames);
+	fprintf(fp, "feature detection: %lu times, every %.1f frames\n", st->num_detect,
+			st->num_detect ? (double)st->num_frames / st->num_detect : 0.0);
+	if(st->num_recorded || st->num_rec_dropped) {
+		fprintf(fp, "recorded %lu frames, %lu frames dropped from the recording\n",
+				st->num_recorded, st->num_rec_dropped);
+	}
+	if(st->num_segmented) {
+		fprintf(fp, "hand segmentation: %lu frames (%.1f%%) analysed within the hand window\n",
+				st->num_segmented, 100.0 * st->num_segmented / st->num_frames);
+	}
+	print_governor_stats(fp, &st->gov);
 }
 
+bool direction_correct(double dir, float truth)
+{
+	if(truth == 0.0) {
+		return dir == 0.0;
+	}
+	/* the truth is in the unmirrored image */
+	return dir * truth < 0.0;
+}
 
-static unsigned long get_msec()
+int parse_roi(const char *str, cv::Rect_<float> *roi)
 {
-	static struct timeval tv0;
-	struct timeval tv;
+	float x, y, w, h;
 
-	gettimeofday(&tv, 0);
-	if(tv0.tv_sec == 0 && tv0.tv_usec == 0) {
-		tv0 = tv;
-		return 0;
+	if(sscanf(str, "%f,%f,%f,%f", &x, &y, &w, &h) != 4) {
+		return -1;
+	}
+	if(x < 0.0 || y < 0.0 || w <= 0.0 || h <= 0.0 || x + w > 1.0 || y + h > 1.0) {
+		return -1;
 	}
-	return (tv.tv_sec - tv0.tv_sec) * 1000 + (tv.tv_usec - tv0.tv_usec) / 1000;
+	*roi = cv::Rect_<float>(x, y, w, h);
+	return 0;
 }
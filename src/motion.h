@@ -19,16 +19,159 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MOTION_H_
 #define MOTION_H_
 
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
 #include <opencv2/opencv.hpp>
+#include "frmsrc.h"
+#include "mengine.h"
+#include "governor.h"
+#include "handseg.h"
+#include "recfile.h"
+#include "mailbox.h"
+#include "mgate.h"
 
-extern bool stop_capture;
-extern int pipefd[2];
-extern cv::Mat frm;
+#define NOTIFY_EOS	(1ull << 32)
+
+/* stages of the capture pipeline, each running on its own thread */
+enum {
+	STAGE_GRAB,		/* read a frame from the frame source */
+	STAGE_PREP,		/* mirror and convert to grayscale */
+	STAGE_FLOW,		/* motion analysis */
+	STAGE_PUBLISH,	/* hand the frame and the overlay data to the render loop */
+	NUM_STAGES
+};
+
+/* what happens when the pipeline can't keep up with the frame source */
+enum DropPolicy {
+	DROP_NONE,		/* process every frame, the grab stage waits for the rest */
+	DROP_STALE		/* skip frames with newer ones queued behind them, and discard
+					   new frames while the whole pipeline is busy */
+};
+
+struct MotionResult {
+	double dir;							/* horizontal motion in frame pixels */
+	std::vector<cv::Point2f> from, to;	/* flow tracks in frame coordinates */
+	cv::Point2f shift;					/* global translation in frame pixels */
+	float confidence;					/* of the translation, in [0, 1] */
+	cv::Rect hand;						/* segmented hand window, if any */
+	bool gated;							/* skipped by the static scene gate */
+};
+
+/* a frame travelling through the capture pipeline */
+struct FramePacket {
+	cv::Mat raw;			/* grabbed frame */
+	cv::Mat col;			/* mirrored BGR frame */
+	cv::Mat gray;			/* mirrored 8bit grayscale frame */
+	MotionResult res;
+
+	unsigned long msec;		/* source timestamp (see FrameSource::timestamp) */
+	uint64_t t_grab;		/* get_usec() when the frame was grabbed */
+	uint64_t t_publish;	/* get_usec() when it was published */
+	unsigned long usec[NUM_STAGES];
+	unsigned long detections;	/* corner detection runs so far */
+	GovernorStats gov;		/* quality governor state so far */
+	unsigned long discarded;	/* frames discarded by grab before this one */
+	float truth;
+	bool has_truth;
+	bool dropped;			/* stale, passes through the stages unprocessed */
+	bool eos;				/* end of stream marker */
+};
+
+struct MotionStats {
+	unsigned long num_frames;	/* frames published */
+	unsigned long num_dropped;	/* stale or discarded frames */
+	unsigned long num_detect;	/* corner detection runs */
+	unsigned long num_gated;	/* static frames which skipped motion analysis */
+	unsigned long num_segmented;	/* frames analysed only within the hand window */
+	unsigned long num_right, num_left;
+	unsigned long num_truth;	/* frames with a known ground truth direction */
+	unsigned long num_correct;	/* of which classified correctly */
+	unsigned long wall_usec;	/* from the first grab to the last publish */
+	unsigned long stage_usec[NUM_STAGES];
+	unsigned long latency_usec;	/* grab to publish, over all published frames */
+	GovernorStats gov;
+	unsigned long num_recorded;	/* frames written to the recording */
+	unsigned long num_rec_dropped;	/* frames the recording couldn't keep up with */
+	unsigned long preview_usec;	/* preview downscaling, in the publish stage */
+};
+
+/* tunables of the motion pipeline, read by the capture thread at startup */
+struct MotionParams {
+	const char *engine;	/* motion engine name, see create_motion_engine */
+	int num_features;	/* tracked features of the lk engine */
+	int pyr_levels;		/* optical flow pyramid levels above the base level */
+	int win_size;		/* optical flow search window size */
+	float proc_scale;	/* motion analysis runs on the roi downscaled by this */
+	cv::Rect_<float> roi;	/* region of interest, in [0, 1] frame coordinates */
+	DropPolicy drop;
+	bool gate;			/* skip motion analysis on static frames */
+	bool overlay;		/* pass the flow vectors to the render loop for display */
+	float frame_budget;	/* msec of motion analysis per frame (0: no governor) */
+	bool segment;		/* restrict motion analysis to the moving hand */
+	int tiles;			/* lk engine tile grid per side (1: untiled) */
+	int threads;		/* threads of the tiled lk engine (0: one per CPU) */
+	const char *record;	/* file to record the frames and results to, or null */
+	cv::Size preview;	/* size of the published preview images (0x0: none) */
+};
+
+/* per capture thread state of the motion pipeline */
+struct MotionContext {
+	MotionParams params;	/* motion_params, as adjusted by the governor */
+	MotionGate gate;
+	HandSegmenter seg;
+	MotionEngine *engine;
+	MotionEstimate est;
+	std::vector<float> dx, dy, scratch;	/* used by estimate_translation */
+	cv::Mat proc_frm;	/* downscaled region of interest */
+	cv::Rect roi;		/* region of interest in frame pixels */
+	float sx, sy;		/* frame to processed image scale factors */
+};
+
+extern MotionParams motion_params;
+extern std::atomic<bool> stop_capture;
+/* eventfd the capture thread adds 1 to for every published frame, and
+ * NOTIFY_EOS to when the frame source runs out of frames
+ */
+extern int notify_fd;
+extern FrameMailbox frm_mbox;
 extern pthread_t ptd;
+extern MotionStats motion_stats;
+/* if set, called from the capture thread for every published frame */
+extern void (*motion_frame_cb)(const FramePacket *pkt);
 
-bool start_capture();
+/* the capture thread takes ownership of the frame source, runs the capture
+ * pipeline, publishes every frame with its direction in frm_mbox and signals
+ * notify_fd. The reader closes notify_fd after it has seen NOTIFY_EOS.
+ */
+bool start_capture(FrameSource *src);
+/* stops the capture thread, if it's running, and waits for it to finish */
+void end_capture(void);
 void *capture_thread(void *arg);
-double calculate_motion_dir(cv::Mat &frm8b, cv::Mat &prev_frm8b, cv::Mat &colimg);
-double calculate_orientation(cv::Mat &frm, cv::Mat &prev_frm);
+/* runs motion analysis on the roi of frm8b, captured at msec, and returns the
+ * horizontal motion in frame pixels. The flow tracks are returned in full frame
+ * coordinates.
+ */
+double calculate_motion_dir(MotionContext *ctx, const cv::Mat &frm8b, unsigned long msec,
+		MotionResult *res);
+
+/* Outlier robust global translation of a set of tracks, in frame pixels.
+ * Tracks which moved less than min_len are static background and ignored. The
+ * translation is the mean of the moving tracks within a few median absolute
+ * deviations of their median. Returns the confidence of the estimate: the
+ * fraction of moving tracks which agree with it, scaled down when there are
+ * only a few of them.
+ */
+float estimate_translation(MotionContext *ctx, const std::vector<cv::Point2f> &from,
+		const std::vector<cv::Point2f> &to, float min_len, cv::Point2f *shift);
+
+void print_motion_stats(FILE *fp, const MotionStats *st);
+
+/* checks a computed direction against the ground truth of a frame source */
+bool direction_correct(double dir, float truth);
+
+/* parses a region of interest given as "x,y,w,h", returns -1 on error */
+int parse_roi(const char *str, cv::Rect_<float> *roi);
 
 #endif /* MOTION_H_ */
@@ -0,0 +1,205 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "preproc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+/* the grayscale weights the capture pipeline has always used (CV_RGB2GRAY on
+ * BGR frames) in 14bit fixed point, with the rounding term. This is exactly
+ * what cvtColor computes for 8bit images.
+ */
+#define GRAY_W0		4899
+#define GRAY_W1		9617
+#define GRAY_W2		1868
+#define GRAY_SHIFT	14
+#define GRAY_ROUND	(1 << (GRAY_SHIFT - 1))
+
+static void mirror_gray_row(const unsigned char *src, unsigned char *col,
+		unsigned char *gray, int x, int width);
+#ifdef USE_SSSE3
+static int mirror_gray_row_ssse3(const unsigned char *src, unsigned char *col,
+		unsigned char *gray, int width);
+#endif
+
+void mirror_gray(const cv::Mat &src, cv::Mat &col, cv::Mat &gray)
+{
+	CV_Assert(src.type() == CV_8UC3);
+
+	col.create(src.rows, src.cols, CV_8UC3);
+	gray.create(src.rows, src.cols, CV_8UC1);
+
+#ifdef USE_SSSE3
+	static int have_ssse3 = -1;
+	if(have_ssse3 == -1) {
+		have_ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+	}
+#endif
+
+	for(int i=0; i<src.rows; i++) {
+		const unsigned char *sptr = src.ptr(i);
+		unsigned char *cptr = col.ptr(i);
+		unsigned char *gptr = gray.ptr(i);
+		int x = 0;
+
+#ifdef USE_SSSE3
+		if(have_ssse3) {
+			x = mirror_gray_row_ssse3(sptr, cptr, gptr, src.cols);
+		}
+#endif
+		mirror_gray_row(sptr, cptr, gptr, x, src.cols);
+	}
+}
+
+/* pixels x to width of a row */
+static void mirror_gray_row(const unsigned char *src, unsigned char *col,
+		unsigned char *gray, int x, int width)
+{
+	const unsigned char *sptr = src + (width - 1 - x) * 3;
+	unsigned char *cptr = col + x * 3;
+
+	for(; x<width; x++) {
+		unsigned int c0 = sptr[0];
+		unsigned int c1 = sptr[1];
+		unsigned int c2 = sptr[2];
+
+		cptr[0] = c0;
+		cptr[1] = c1;
+		cptr[2] = c2;
+		gray[x] = (c0 * GRAY_W0 + c1 * GRAY_W1 + c2 * GRAY_W2 + GRAY_ROUND) >> GRAY_SHIFT;
+
+		sptr -= 3;
+		cptr += 3;
+	}
+}
+
+#ifdef USE_SSSE3
+#define Z	0x80	/* pshufb index which produces a zero byte */
+
+/* mirrored block byte k = source block byte 3 * (15 - k / 3) + k % 3, which
+ * spans up to three source registers per destination register
+ */
+static const unsigned char mirror_mask[7][16] __attribute__((aligned(16))) = {
+	{Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 14},			/* d0 <- s1 */
+	{13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, Z},		/* d0 <- s2 */
+	{Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 15, Z},			/* d1 <- s0 */
+	{15, Z, 11, 12, 13, 8, 9, 10, 5, 6, 7, 2, 3, 4, Z, 0},		/* d1 <- s1 */
+	{Z, 0, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},			/* d1 <- s2 */
+	{Z, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2},		/* d2 <- s0 */
+	{1, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z}			/* d2 <- s1 */
+};
+
+/* channel c of pixel i = source block byte 3 * i + c */
+static const unsigned char plane_mask[3][3][16] __attribute__((aligned(16))) = {
+	{
+		{0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+		{Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14, Z, Z, Z, Z, Z},
+		{Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 1, 4, 7, 10, 13}
+	},
+	{
+		{1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+		{Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z},
+		{Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14}
+	},
+	{
+		{2, 5, 8, 11, 14, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+		{Z, Z, Z, Z, Z, 1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z},
+		{Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15}
+	}
+};
+
+static const unsigned char reverse_mask[16] __attribute__((aligned(16))) = {
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+};
+
+#define MASK(m)	_mm_load_si128((const __m128i*)(m))
+
+__attribute__((target("ssse3")))
+static inline __m128i gather_plane(__m128i s0, __m128i s1, __m128i s2, int c)
+{
+	return _mm_or_si128(_mm_or_si128(
+				_mm_shuffle_epi8(s0, MASK(plane_mask[c][0])),
+				_mm_shuffle_epi8(s1, MASK(plane_mask[c][1]))),
+			_mm_shuffle_epi8(s2, MASK(plane_mask[c][2])));
+}
+
+/* weighted sum of 4 pixels: c0/c1 and c2/1 16bit pairs through pmaddwd */
+__attribute__((target("ssse3")))
+static inline __m128i gray4(__m128i c01, __m128i c2r)
+{
+	const __m128i w01 = _mm_set1_epi32((GRAY_W1 << 16) | GRAY_W0);
+	const __m128i w2r = _mm_set1_epi32((GRAY_ROUND << 16) | GRAY_W2);
+
+	__m128i sum = _mm_add_epi32(_mm_madd_epi16(c01, w01), _mm_madd_epi16(c2r, w2r));
+	return _mm_srli_epi32(sum, GRAY_SHIFT);
+}
+
+/* processes 16 pixel blocks, returns the number of pixels done */
+__attribute__((target("ssse3")))
+static int mirror_gray_row_ssse3(const unsigned char *src, unsigned char *col,
+		unsigned char *gray, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	int x;
+
+	for(x=0; x<=width - 16; x+=16) {
+		/* the source block which mirrors onto pixels x to x + 15 */
+		const unsigned char *sptr = src + (width - 16 - x) * 3;
+		__m128i s0 = _mm_loadu_si128((const __m128i*)sptr);
+		__m128i s1 = _mm_loadu_si128((const __m128i*)(sptr + 16));
+		__m128i s2 = _mm_loadu_si128((const __m128i*)(sptr + 32));
+
+		__m128i d0 = _mm_or_si128(_mm_shuffle_epi8(s1, MASK(mirror_mask[0])),
+				_mm_shuffle_epi8(s2, MASK(mirror_mask[1])));
+		__m128i d1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(s0, MASK(mirror_mask[2])),
+					_mm_shuffle_epi8(s1, MASK(mirror_mask[3]))),
+				_mm_shuffle_epi8(s2, MASK(mirror_mask[4])));
+		__m128i d2 = _mm_or_si128(_mm_shuffle_epi8(s0, MASK(mirror_mask[5])),
+				_mm_shuffle_epi8(s1, MASK(mirror_mask[6])));
+
+		_mm_storeu_si128((__m128i*)(col + x * 3), d0);
+		_mm_storeu_si128((__m128i*)(col + x * 3 + 16), d1);
+		_mm_storeu_si128((__m128i*)(col + x * 3 + 32), d2);
+
+		/* grayscale in source order, reversed at the end */
+		__m128i c0 = gather_plane(s0, s1, s2, 0);
+		__m128i c1 = gather_plane(s0, s1, s2, 1);
+		__m128i c2 = gather_plane(s0, s1, s2, 2);
+
+		__m128i c0l = _mm_unpacklo_epi8(c0, zero);
+		__m128i c0h = _mm_unpackhi_epi8(c0, zero);
+		__m128i c1l = _mm_unpacklo_epi8(c1, zero);
+		__m128i c1h = _mm_unpackhi_epi8(c1, zero);
+		__m128i c2l = _mm_unpacklo_epi8(c2, zero);
+		__m128i c2h = _mm_unpackhi_epi8(c2, zero);
+
+		__m128i g0 = gray4(_mm_unpacklo_epi16(c0l, c1l), _mm_unpacklo_epi16(c2l, one));
+		__m128i g1 = gray4(_mm_unpackhi_epi16(c0l, c1l), _mm_unpackhi_epi16(c2l, one));
+		__m128i g2 = gray4(_mm_unpacklo_epi16(c0h, c1h), _mm_unpacklo_epi16(c2h, one));
+		__m128i g3 = gray4(_mm_unpackhi_epi16(c0h, c1h), _mm_unpackhi_epi16(c2h, one));
+
+		__m128i g = _mm_packus_epi16(_mm_packs_epi32(g0, g1), _mm_packs_epi32(g2, g3));
+		_mm_storeu_si128((__m128i*)(gray + x), _mm_shuffle_epi8(g, MASK(reverse_mask)));
+	}
+	return x;
+}
+#endif	/* USE_SSSE3 */
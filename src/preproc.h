@@ -0,0 +1,30 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PREPROC_H_
+#define PREPROC_H_
+
+#include <opencv2/opencv.hpp>
+
+/* Mirrors the BGR frame src horizontally into col, and writes the mirrored
+ * 8bit grayscale frame into gray, in a single pass over src. col and gray
+ * are only (re)allocated when their size doesn't match.
+ */
+void mirror_gray(const cv::Mat &src, cv::Mat &col, cv::Mat &gray);
+
+#endif	/* PREPROC_H_ */
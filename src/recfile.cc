@@ -0,0 +1,318 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "recfile.h"
+
+#define REC_BUFFERS		16
+#define REC_BATCH		8		/* frames per write */
+
+static_assert(sizeof(RecFrameMeta) <= REC_META_SIZE, "frame metadata doesn't fit its space");
+
+static size_t align_up(size_t sz)
+{
+	return (sz + REC_ALIGN - 1) / REC_ALIGN * REC_ALIGN;
+}
+
+/* ---- writer ---- */
+
+RecWriter::RecWriter()
+{
+	fd = -1;
+	pool = 0;
+	freeq = fullq = 0;
+	running = failed = false;
+	num_written = num_dropped = 0;
+}
+
+RecWriter::~RecWriter()
+{
+	close();
+}
+
+bool RecWriter::open(const char *fname, int width, int height, int type)
+{
+	int res;
+
+	close();
+
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.magic, REC_MAGIC, sizeof hdr.magic);
+	hdr.version = REC_VERSION;
+	hdr.width = width;
+	hdr.height = height;
+	hdr.type = type;
+	hdr.stride = width * CV_ELEM_SIZE(type);
+	hdr.rec_size = align_up(REC_META_SIZE + hdr.stride * height);
+
+	if((fd = ::open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+		fprintf(stderr, "failed to open %s for recording: %s\n", fname, strerror(errno));
+		return false;
+	}
+
+	/* the header is rewritten with the frame count on close */
+	char blank[REC_ALIGN];
+	memset(blank, 0, sizeof blank);
+	memcpy(blank, &hdr, sizeof hdr);
+	if(write(fd, blank, sizeof blank) != (ssize_t)sizeof blank) {
+		perror("failed to write recording header");
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+
+	if(posix_memalign((void**)&pool, REC_ALIGN, (size_t)hdr.rec_size * REC_BUFFERS) != 0) {
+		fprintf(stderr, "failed to allocate recording buffers\n");
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+	freeq = new SPSCQueue<unsigned char*>(REC_BUFFERS);
+	fullq = new SPSCQueue<unsigned char*>(REC_BUFFERS + 1);	/* + end marker */
+	for(int i=0; i<REC_BUFFERS; i++) {
+		freeq->push(pool + (size_t)i * hdr.rec_size);
+	}
+
+	failed = false;
+	num_written = num_dropped = 0;
+
+	if((res = pthread_create(&td, 0, writer_thread, this)) != 0) {
+		fprintf(stderr, "failed to create recording thread: %s\n", strerror(res));
+		close();
+		return false;
+	}
+	running = true;
+	return true;
+}
+
+bool RecWriter::add(const cv::Mat &frm, const RecFrameMeta *meta)
+{
+	unsigned char *buf;
+
+	if(!running || failed || frm.cols != (int)hdr.width || frm.rows != (int)hdr.height ||
+			frm.type() != (int)hdr.type || !freeq->pop(&buf)) {
+		num_dropped++;
+		return false;
+	}
+
+	memset(buf, 0, REC_META_SIZE);
+	memcpy(buf, meta, sizeof *meta);
+
+	unsigned char *pix = buf + REC_META_SIZE;
+	for(int i=0; i<frm.rows; i++) {
+		memcpy(pix + i * hdr.stride, frm.ptr(i), hdr.stride);
+	}
+
+	fullq->push(buf);
+	return true;
+}
+
+void RecWriter::close()
+{
+	if(running) {
+		fullq->push(0);
+		pthread_join(td, 0);
+		running = false;
+	}
+
+	if(fd != -1) {
+		hdr.num_frames = num_written;
+		if(pwrite(fd, &hdr, sizeof hdr, 0) != (ssize_t)sizeof hdr) {
+			perror("failed to finish the recording header");
+		}
+		::close(fd);
+		fd = -1;
+	}
+
+	delete freeq;
+	delete fullq;
+	freeq = fullq = 0;
+	free(pool);
+	pool = 0;
+}
+
+bool RecWriter::is_open() const
+{
+	return running;
+}
+
+unsigned long RecWriter::frames() const
+{
+	return num_written;
+}
+
+unsigned long RecWriter::dropped() const
+{
+	return num_dropped;
+}
+
+void *RecWriter::writer_thread(void *arg)
+{
+	RecWriter *rw = (RecWriter*)arg;
+	unsigned char *batch[REC_BATCH];
+	struct iovec iov[REC_BATCH];
+	bool done = false;
+
+	while(!done) {
+		int count = 0;
+
+		/* wait for one frame, then take whatever else is queued */
+		rw->fullq->wait_pop(batch);
+		if(!batch[0]) break;
+		count++;
+
+		while(count < REC_BATCH && rw->fullq->pop(batch + count)) {
+			if(!batch[count]) {
+				done = true;
+				break;
+			}
+			count++;
+		}
+
+		if(!rw->failed) {
+			size_t total = 0;
+			for(int i=0; i<count; i++) {
+				iov[i].iov_base = batch[i];
+				iov[i].iov_len = rw->hdr.rec_size;
+				total += rw->hdr.rec_size;
+			}
+
+			/* regular files don't do short writes short of errors */
+			if(writev(rw->fd, iov, count) != (ssize_t)total) {
+				perror("failed to write recording, stopped recording");
+				rw->failed = true;
+			} else {
+				rw->num_written += count;
+			}
+		}
+
+		for(int i=0; i<count; i++) {
+			rw->freeq->push(batch[i]);
+		}
+	}
+	return 0;
+}
+
+/* ---- reader ---- */
+
+RecReader::RecReader()
+{
+	fd = -1;
+	map = 0;
+	map_size = 0;
+	hdr = 0;
+	nframes = 0;
+}
+
+RecReader::~RecReader()
+{
+	close();
+}
+
+bool RecReader::open(const char *fname)
+{
+	struct stat st;
+
+	close();
+
+	if((fd = ::open(fname, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		fprintf(stderr, "failed to open recording %s: %s\n", fname, strerror(errno));
+		close();
+		return false;
+	}
+	if(st.st_size < REC_ALIGN) {
+		fprintf(stderr, "%s is not a recording\n", fname);
+		close();
+		return false;
+	}
+
+	map_size = st.st_size;
+	if((map = (unsigned char*)mmap(0, map_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "failed to map recording %s: %s\n", fname, strerror(errno));
+		map = 0;
+		close();
+		return false;
+	}
+
+	hdr = (const RecHeader*)map;
+	/* a bad geometry would have frame() hand out rows past the mapping */
+	if(memcmp(hdr->magic, REC_MAGIC, sizeof hdr->magic) != 0 || hdr->version != REC_VERSION ||
+			hdr->type != (uint32_t)CV_MAT_TYPE(hdr->type) || !hdr->width || !hdr->height ||
+			hdr->stride < (uint64_t)hdr->width * CV_ELEM_SIZE(hdr->type) ||
+			hdr->rec_size < REC_META_SIZE + (uint64_t)hdr->stride * hdr->height) {
+		fprintf(stderr, "%s is not a recording, or of an unsupported version\n", fname);
+		close();
+		return false;
+	}
+
+	/* recordings which were cut short have all the frames that made it */
+	long avail = (map_size - REC_ALIGN) / hdr->rec_size;
+	nframes = hdr->num_frames ? std::min((long)hdr->num_frames, avail) : avail;
+
+	madvise(map, map_size, MADV_SEQUENTIAL);
+	return true;
+}
+
+void RecReader::close()
+{
+	if(map) {
+		munmap(map, map_size);
+		map = 0;
+	}
+	if(fd != -1) {
+		::close(fd);
+		fd = -1;
+	}
+	hdr = 0;
+	nframes = 0;
+}
+
+long RecReader::num_frames() const
+{
+	return nframes;
+}
+
+int RecReader::width() const
+{
+	return hdr ? hdr->width : 0;
+}
+
+int RecReader::height() const
+{
+	return hdr ? hdr->height : 0;
+}
+
+const RecFrameMeta *RecReader::meta(long idx) const
+{
+	return (const RecFrameMeta*)(map + REC_ALIGN + (size_t)idx * hdr->rec_size);
+}
+
+cv::Mat RecReader::frame(long idx) const
+{
+	unsigned char *pix = (unsigned char*)meta(idx) + REC_META_SIZE;
+	return cv::Mat(hdr->height, hdr->width, hdr->type, pix, hdr->stride);
+}
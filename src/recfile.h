@@ -0,0 +1,128 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RECFILE_H_
+#define RECFILE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+#include "spscq.h"
+
+/* Raw capture recording. The file is a header followed by fixed size frame
+ * records, each holding the frame metadata followed by the raw frame pixels.
+ * The header and every record are padded to REC_ALIGN bytes, so frame i is at
+ * a fixed offset and a reader can map the file and use the pixels in place.
+ * Integers are stored in host byte order.
+ */
+#define REC_MAGIC		"VKBREC1"
+#define REC_VERSION		1
+#define REC_ALIGN		4096
+#define REC_META_SIZE	128		/* frame pixels start this far into a record */
+
+enum {
+	REC_GATED		= 1,	/* the static scene gate skipped this frame */
+	REC_HAS_TRUTH	= 2,	/* truth is valid */
+	REC_DROPPED		= 4		/* stale, dropped by the pipeline unprocessed */
+};
+
+struct RecHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t width, height;
+	uint32_t type;			/* opencv pixel type */
+	uint32_t stride;		/* bytes per pixel row */
+	uint32_t rec_size;		/* bytes per frame record */
+	uint32_t num_frames;	/* written on close, 0 if the recording was cut short */
+};
+
+struct RecFrameMeta {
+	uint64_t msec;			/* source timestamp (see FrameSource::timestamp) */
+	uint64_t seq;			/* published frame number */
+	double dir;				/* computed direction */
+	float shift_x, shift_y;	/* global translation */
+	float confidence;
+	float truth;			/* ground truth of the source, if REC_HAS_TRUTH */
+	uint32_t flags;
+	uint32_t num_tracks;	/* tracker state: surviving flow tracks */
+	uint32_t detections;	/* and feature detections so far */
+	/* quality governor settings at the time */
+	uint32_t num_features, pyr_levels;
+	float proc_scale;
+	int32_t hand_x, hand_y, hand_w, hand_h;		/* segmented hand window */
+};
+
+/* Writes a recording without ever blocking the caller: add copies the frame
+ * into a free buffer and queues it, and a writer thread writes the queued
+ * frames out in batches. When all buffers are in flight the frame is dropped
+ * from the recording instead.
+ */
+class RecWriter {
+private:
+	int fd;
+	RecHeader hdr;
+	unsigned char *pool;	/* all the buffers, rec_size bytes each */
+	SPSCQueue<unsigned char*> *freeq, *fullq;
+	pthread_t td;
+	bool running;
+	std::atomic<bool> failed;	/* set by the writer thread */
+	unsigned long num_written, num_dropped;
+
+	static void *writer_thread(void *arg);
+
+public:
+	RecWriter();
+	~RecWriter();
+
+	bool open(const char *fname, int width, int height, int type);
+	/* returns false if the frame was dropped */
+	bool add(const cv::Mat &frm, const RecFrameMeta *meta);
+	/* writes out the queued frames and finishes the file */
+	void close();
+
+	bool is_open() const;
+	unsigned long frames() const;		/* valid after close */
+	unsigned long dropped() const;
+};
+
+/* memory mapped recording */
+class RecReader {
+private:
+	int fd;
+	unsigned char *map;
+	size_t map_size;
+	const RecHeader *hdr;
+	long nframes;
+
+public:
+	RecReader();
+	~RecReader();
+
+	bool open(const char *fname);
+	void close();
+
+	long num_frames() const;
+	int width() const;
+	int height() const;
+	const RecFrameMeta *meta(long idx) const;
+	/* header over the mapped pixels of frame idx, which must not be written */
+	cv::Mat frame(long idx) const;
+};
+
+#endif	/* RECFILE_H_ */
@@ -0,0 +1,532 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define GL_GLEXT_PROTOTYPES
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "render.h"
+#include "vkeyb.h"
+#include "mailbox.h"
+
+#define STATUS_FONT		"-*-helvetica-medium-r-*-*-18-*-*-*-*-*-iso8859-1"
+#define FALLBACK_FONT	"fixed"
+
+/* the translation is per frame, exaggerate it to be visible */
+#define MOTION_VEC_SCALE	8
+
+/* interleaved vertex: x, y, u, v */
+#define VERT_SIZE		(4 * sizeof(float))
+
+static const char *vs_src =
+	"#version 120\n"
+	"attribute vec2 pos;\n"
+	"attribute vec2 uv;\n"
+	"uniform vec4 xform;\n"
+	"varying vec2 tc;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = vec4(pos * xform.xy + xform.zw, 0.0, 1.0);\n"
+	"	tc = uv;\n"
+	"}\n";
+
+static const char *ps_src =
+	"#version 120\n"
+	"uniform sampler2D tex;\n"
+	"uniform vec4 color;\n"
+	"uniform bool textured;\n"
+	"varying vec2 tc;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = textured ? texture2D(tex, tc) * color : color;\n"
+	"}\n";
+
+static unsigned int create_program(const char *vsrc, const char *psrc);
+static unsigned int create_shader(unsigned int type, const char *src);
+static unsigned int create_vbo(const float *data, int nverts, unsigned int usage);
+static void add_vertex(std::vector<float> &v, float x, float y, float u = 0.0, float tv = 0.0);
+static void add_quad(std::vector<float> &v, float x0, float y0, float x1, float y1,
+		float u0, float v0, float u1, float v1);
+
+Renderer::Renderer()
+{
+	prog = 0;
+	strip_vbo = sel_vbo = preview_vbo = overlay_vbo = text_vbo = 0;
+	preview_width = 0.0;
+	overlay_seq = 0;
+	overlay_flow = overlay_verts = 0;
+	font.pixels = 0;
+	font_tex = 0;
+	text_verts = 0;
+	strip_valid = false;
+	strip_gen = 0;
+	strip_glyphs = strip_words = strip_labels = 0;
+	win_width = win_height = 1;
+	num_frames = frame_usec = 0;
+}
+
+Renderer::~Renderer()
+{
+	unsigned int vbo[] = {strip_vbo, sel_vbo, preview_vbo, overlay_vbo, text_vbo};
+
+	glDeleteBuffers(sizeof vbo / sizeof *vbo, vbo);
+	if(font_tex) {
+		glDeleteTextures(1, &font_tex);
+	}
+	if(prog) {
+		glDeleteProgram(prog);
+	}
+	xfont_free(&font);
+}
+
+bool Renderer::init(Display *dpy, const VKeyb *kb)
+{
+	if(!(prog = create_program(vs_src, ps_src))) {
+		return false;
+	}
+	u_xform = glGetUniformLocation(prog, "xform");
+	u_color = glGetUniformLocation(prog, "color");
+	u_textured = glGetUniformLocation(prog, "textured");
+	a_pos = glGetAttribLocation(prog, "pos");
+	a_uv = glGetAttribLocation(prog, "uv");
+
+	glUseProgram(prog);
+	glUniform1i(glGetUniformLocation(prog, "tex"), 0);
+	glUseProgram(0);
+
+	float rect_width = 2.0 / kb->num_visible();
+	float sel[] = {
+		0, -1, 0, 0,
+		rect_width, -1, 0, 0,
+		rect_width, 1, 0, 0,
+		0, 1, 0, 0
+	};
+	sel_vbo = create_vbo(sel, 4, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &strip_vbo);
+	glGenBuffers(1, &preview_vbo);
+	glGenBuffers(1, &overlay_vbo);
+	glGenBuffers(1, &text_vbo);
+
+	if(!xfont_atlas(dpy, STATUS_FONT, &font) && !xfont_atlas(dpy, FALLBACK_FONT, &font)) {
+		return false;
+	}
+
+	/* white glyphs with the coverage as alpha, tinted by the color uniform */
+	unsigned char *rgba = (unsigned char*)malloc(font.width * font.height * 4);
+	if(!rgba) {
+		fprintf(stderr, "failed to allocate the font texture\n");
+		return false;
+	}
+	for(int i=0; i<font.width * font.height; i++) {
+		rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 255;
+		rgba[i * 4 + 3] = font.pixels[i];
+	}
+
+	glGenTextures(1, &font_tex);
+	glBindTexture(GL_TEXTURE_2D, font_tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, font.width, font.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	free(rgba);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void Renderer::resize(int w, int h)
+{
+	win_width = w > 0 ? w : 1;
+	win_height = h > 0 ? h : 1;
+	/* the completion labels are sized in window pixels */
+	strip_valid = false;
+}
+
+/* Every cell of the ring, rebuilt when the ring changes: glyph quads over the
+ * atlas, then the completion cells and their labels. The cells are laid out
+ * in slot units, slot i from x = i to i + 1, followed by the first visible
+ * cells again, so that any scroll position shows a contiguous run of them.
+ */
+void Renderer::draw_strip(const VKeyb *kb)
+{
+	int vis = kb->num_visible();
+	float cell_w = 2.0 / vis;
+
+	if(!strip_valid || kb->generation() != strip_gen) {
+		int ncells = kb->num_slots() + vis + 1;
+		float glyph_u = 1.0 / kb->glyph_count();
+
+		verts.clear();
+		for(int i=0; i<ncells; i++) {
+			int g = kb->slot_glyph(i);
+			if(g >= 0) {
+				add_quad(verts, i, -1, i + 1, 1, g * glyph_u, 1, (g + 1) * glyph_u, 0);
+			}
+		}
+		strip_glyphs = verts.size() / 4;
+
+		for(int i=0; i<ncells; i++) {
+			if(kb->slot_glyph(i) < 0) {
+				add_quad(verts, i, -1, i + 1, 1, 0, 0, 0, 0);
+			}
+		}
+		strip_words = verts.size() / 4 - strip_glyphs;
+
+		/* window pixels in slot units */
+		float sx = 2.0 / win_width / cell_w, sy = 2.0 / win_height;
+		for(int i=0; i<ncells; i++) {
+			const char *word = kb->slot_word(i);
+			if(word) {
+				float x = i + 0.5 - text_width(word) * sx / 2;
+				float y = -(font.ascent - font.descent) * sy / 2;
+				add_text(verts, x, y, sx, sy, word);
+			}
+		}
+		strip_labels = verts.size() / 4 - strip_glyphs - strip_words;
+
+		glBindBuffer(GL_ARRAY_BUFFER, strip_vbo);
+		glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.empty() ? 0 : &verts[0],
+				GL_DYNAMIC_DRAW);
+		strip_valid = true;
+		strip_gen = kb->generation();
+	}
+
+	glUseProgram(prog);
+	/* scrolling only moves the strip */
+	set_xform(cell_w, 1, -kb->first_visible() * cell_w - 1, 0);
+	bind_buffer(strip_vbo);
+
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, kb->texture());
+	glUniform1i(u_textured, 1);
+	glUniform4f(u_color, 1, 1, 1, 1);
+	glDrawArrays(GL_TRIANGLES, 0, strip_glyphs);
+
+	if(strip_words) {
+		glUniform1i(u_textured, 0);
+		glUniform4f(u_color, 0.15, 0.15, 0.3, 1);
+		glDrawArrays(GL_TRIANGLES, strip_glyphs, strip_words);
+
+		glBindTexture(GL_TEXTURE_2D, font_tex);
+		glUniform1i(u_textured, 1);
+		glUniform4f(u_color, 1, 1, 1, 1);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDrawArrays(GL_TRIANGLES, strip_glyphs + strip_words, strip_labels);
+		glDisable(GL_BLEND);
+	}
+	glDisable(GL_TEXTURE_2D);
+
+	glUniform1i(u_textured, 0);
+	glUniform4f(u_color, 1, 0, 0, 1);
+	glLineWidth(2.0);
+
+	set_xform(1, 1, 0, 0);
+	bind_buffer(sel_vbo);
+	glDrawArrays(GL_LINE_LOOP, 0, 4);
+
+	glUseProgram(0);
+}
+
+void Renderer::draw_preview(unsigned int tex, float frm_width)
+{
+	frm_width *= 2;
+
+	if(frm_width != preview_width) {
+		float quad[] = {
+			-1, -1, 0, 1,
+			frm_width - 1, -1, 1, 1,
+			-1, 1, 0, 0,
+			frm_width - 1, 1, 1, 0
+		};
+		glBindBuffer(GL_ARRAY_BUFFER, preview_vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof quad, quad, GL_STATIC_DRAW);
+		preview_width = frm_width;
+	}
+
+	glUseProgram(prog);
+	set_xform(1, 1, 0, 0);
+
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glUniform1i(u_textured, 1);
+	glUniform4f(u_color, 1, 1, 1, 1);
+
+	bind_buffer(preview_vbo);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glUseProgram(0);
+}
+
+void Renderer::draw_overlay(const FrameSlot *slot, float frm_width)
+{
+	if(!slot || !slot->img.cols) {
+		return;
+	}
+	frm_width *= 2;
+
+	if(slot->seq != overlay_seq) {
+		/* flow pairs, then the translation (horizontal component too), then
+		 * the hand window
+		 */
+		verts.clear();
+		for(size_t i=0; i<slot->flow.size(); i++) {
+			add_vertex(verts, slot->flow[i].x, slot->flow[i].y);
+		}
+		overlay_flow = slot->flow.size();
+
+		float cx = (int)(slot->img.cols / 2.0);
+		float cy = (int)(slot->img.rows / 2.0);
+		float mx = slot->motion_vec.x * MOTION_VEC_SCALE;
+		float my = slot->motion_vec.y * MOTION_VEC_SCALE;
+		add_vertex(verts, cx, cy);
+		add_vertex(verts, cx + mx, cy + my);
+		add_vertex(verts, cx, cy);
+		add_vertex(verts, cx + mx, cy);
+
+		const cv::Rect &hand = slot->hand;
+		if(hand.width > 0) {
+			add_vertex(verts, hand.x, hand.y);
+			add_vertex(verts, hand.x + hand.width, hand.y);
+			add_vertex(verts, hand.x + hand.width, hand.y + hand.height);
+			add_vertex(verts, hand.x, hand.y + hand.height);
+		}
+		overlay_verts = verts.size() / 4;
+
+		glBindBuffer(GL_ARRAY_BUFFER, overlay_vbo);
+		glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), &verts[0], GL_STREAM_DRAW);
+		overlay_seq = slot->seq;
+	}
+
+	glUseProgram(prog);
+	/* frame pixels to the preview quad */
+	set_xform(frm_width / slot->img.cols, -2.0 / slot->img.rows, -1, 1);
+	glUniform1i(u_textured, 0);
+
+	glEnable(GL_LINE_SMOOTH);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	bind_buffer(overlay_vbo);
+
+	if(overlay_flow) {
+		glLineWidth(1.0);
+		glUniform4f(u_color, 0, 1, 1, 1);
+		glDrawArrays(GL_LINES, 0, overlay_flow);
+	}
+
+	glLineWidth(3.0);
+	glUniform4f(u_color, 0, 0, 1, 1);
+	glDrawArrays(GL_LINES, overlay_flow, 2);
+	glUniform4f(u_color, 1, 0, 0, 1);
+	glDrawArrays(GL_LINES, overlay_flow + 2, 2);
+
+	if(overlay_verts > overlay_flow + 4) {
+		glLineWidth(2.0);
+		glUniform4f(u_color, 0, 1, 0, 1);
+		glDrawArrays(GL_LINE_LOOP, overlay_flow + 4, 4);
+	}
+
+	glDisable(GL_BLEND);
+	glDisable(GL_LINE_SMOOTH);
+	glUseProgram(0);
+}
+
+void Renderer::draw_text(int x, int y, const char *str)
+{
+	if(text != str) {
+		verts.clear();
+		add_text(verts, 0, 0, 1, 1, str);
+		text_verts = verts.size() / 4;
+
+		glBindBuffer(GL_ARRAY_BUFFER, text_vbo);
+		glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.empty() ? 0 : &verts[0],
+				GL_DYNAMIC_DRAW);
+		text = str;
+	}
+	if(!text_verts) {
+		return;
+	}
+
+	glUseProgram(prog);
+	/* window pixels, with the text origin at x, y */
+	set_xform(2.0 / win_width, 2.0 / win_height, x * 2.0 / win_width - 1, y * 2.0 / win_height - 1);
+
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, font_tex);
+	glUniform1i(u_textured, 1);
+	glUniform4f(u_color, 1, 1, 1, 1);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	bind_buffer(text_vbo);
+	glDrawArrays(GL_TRIANGLES, 0, text_verts);
+
+	glDisable(GL_BLEND);
+	glDisable(GL_TEXTURE_2D);
+	glUseProgram(0);
+}
+
+/* text quads with the baseline origin at x, y and sx, sy units per pixel */
+void Renderer::add_text(std::vector<float> &v, float x, float y, float sx, float sy, const char *str) const
+{
+	for(const char *p=str; *p; p++) {
+		const XFontGlyph *g = glyph(*p);
+
+		/* y up, the atlas is top to bottom */
+		float x0 = x + g->left * sx, x1 = x0 + g->width * sx;
+		float y1 = y + g->top * sy, y0 = y1 - g->height * sy;
+		float u0 = (float)g->x / font.width, u1 = (float)(g->x + g->width) / font.width;
+		float v0 = (float)(g->y + g->height) / font.height, v1 = (float)g->y / font.height;
+
+		add_quad(v, x0, y0, x1, y1, u0, v0, u1, v1);
+		x += g->advance * sx;
+	}
+}
+
+int Renderer::text_width(const char *str) const
+{
+	int width = 0;
+
+	for(const char *p=str; *p; p++) {
+		width += glyph(*p)->advance;
+	}
+	return width;
+}
+
+const XFontGlyph *Renderer::glyph(char c) const
+{
+	int idx = (unsigned char)c - XFONT_FIRST_CHAR;
+	if(idx < 0 || idx >= XFONT_NUM_CHARS) {
+		idx = '?' - XFONT_FIRST_CHAR;
+	}
+	return font.glyph + idx;
+}
+
+void Renderer::add_frame_time(unsigned long usec)
+{
+	num_frames++;
+	frame_usec += usec;
+}
+
+void Renderer::print_stats(FILE *fp) const
+{
+	if(num_frames) {
+		fprintf(fp, "render: %lu frames, %.3f ms/frame\n", num_frames,
+				frame_usec / 1000.0 / num_frames);
+	}
+}
+
+void Renderer::bind_buffer(unsigned int vbo)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glEnableVertexAttribArray(a_pos);
+	glVertexAttribPointer(a_pos, 2, GL_FLOAT, GL_FALSE, VERT_SIZE, 0);
+	if(a_uv != -1) {
+		glEnableVertexAttribArray(a_uv);
+		glVertexAttribPointer(a_uv, 2, GL_FLOAT, GL_FALSE, VERT_SIZE, (void*)(2 * sizeof(float)));
+	}
+}
+
+void Renderer::set_xform(float sx, float sy, float tx, float ty)
+{
+	glUniform4f(u_xform, sx, sy, tx, ty);
+}
+
+static unsigned int create_program(const char *vsrc, const char *psrc)
+{
+	unsigned int vs, ps, prog;
+	int status;
+
+	if(!(vs = create_shader(GL_VERTEX_SHADER, vsrc))) {
+		return 0;
+	}
+	if(!(ps = create_shader(GL_FRAGMENT_SHADER, psrc))) {
+		glDeleteShader(vs);
+		return 0;
+	}
+
+	prog = glCreateProgram();
+	glAttachShader(prog, vs);
+	glAttachShader(prog, ps);
+	glLinkProgram(prog);
+	/* flagged for deletion along with the program */
+	glDeleteShader(vs);
+	glDeleteShader(ps);
+
+	glGetProgramiv(prog, GL_LINK_STATUS, &status);
+	if(!status) {
+		char buf[512];
+		glGetProgramInfoLog(prog, sizeof buf, 0, buf);
+		fprintf(stderr, "failed to link shader program:\n%s\n", buf);
+		glDeleteProgram(prog);
+		return 0;
+	}
+	return prog;
+}
+
+static unsigned int create_shader(unsigned int type, const char *src)
+{
+	unsigned int sdr = glCreateShader(type);
+	int status;
+
+	glShaderSource(sdr, 1, &src, 0);
+	glCompileShader(sdr);
+
+	glGetShaderiv(sdr, GL_COMPILE_STATUS, &status);
+	if(!status) {
+		char buf[512];
+		glGetShaderInfoLog(sdr, sizeof buf, 0, buf);
+		fprintf(stderr, "failed to compile %s shader:\n%s\n",
+				type == GL_VERTEX_SHADER ? "vertex" : "pixel", buf);
+		glDeleteShader(sdr);
+		return 0;
+	}
+	return sdr;
+}
+
+static unsigned int create_vbo(const float *data, int nverts, unsigned int usage)
+{
+	unsigned int vbo;
+
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, nverts * VERT_SIZE, data, usage);
+	return vbo;
+}
+
+static void add_vertex(std::vector<float> &v, float x, float y, float u, float tv)
+{
+	v.push_back(x);
+	v.push_back(y);
+	v.push_back(u);
+	v.push_back(tv);
+}
+
+/* two counterclockwise triangles */
+static void add_quad(std::vector<float> &v, float x0, float y0, float x1, float y1,
+		float u0, float v0, float u1, float v1)
+{
+	add_vertex(v, x0, y0, u0, v0);
+	add_vertex(v, x1, y0, u1, v0);
+	add_vertex(v, x1, y1, u1, v1);
+	add_vertex(v, x0, y0, u0, v0);
+	add_vertex(v, x1, y1, u1, v1);
+	add_vertex(v, x0, y1, u0, v1);
+}
@@ -0,0 +1,89 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <X11/Xlib.h>
+#include "xfont.h"
+
+class VKeyb;
+struct FrameSlot;
+
+/* Retained mode renderer of the keyboard window. All geometry lives in
+ * vertex buffers and is drawn by a single GLSL 1.20 program. The keyboard
+ * strip holds the whole ring, and scrolls by changing only the translation
+ * of the xform uniform; it is re-uploaded only when the ring changes or the
+ * window is resized, and the preview quad only when its width changes. The overlay is
+ * re-uploaded only when a new frame is published, and the status text only
+ * when it changes, as quads over a glyph atlas rasterized from an X core font.
+ */
+class Renderer {
+private:
+	unsigned int prog;
+	int u_xform, u_color, u_textured;
+	int a_pos, a_uv;
+
+	unsigned int strip_vbo, sel_vbo, preview_vbo, overlay_vbo, text_vbo;
+	bool strip_valid;
+	unsigned int strip_gen;	/* ring generation the strip buffer was built from */
+	int strip_glyphs, strip_words, strip_labels;	/* vertices of each part */
+	float preview_width;
+	unsigned long overlay_seq;
+	int overlay_flow, overlay_verts;
+	std::vector<float> verts;	/* scratch space of the dynamic buffers */
+
+	XFontAtlas font;
+	unsigned int font_tex;
+	std::string text;
+	int text_verts;
+
+	int win_width, win_height;
+	unsigned long num_frames, frame_usec;
+
+	void bind_buffer(unsigned int vbo);
+	void set_xform(float sx, float sy, float tx, float ty);
+	void add_text(std::vector<float> &v, float x, float y, float sx, float sy, const char *str) const;
+	int text_width(const char *str) const;
+	const XFontGlyph *glyph(char c) const;
+
+public:
+	Renderer();
+	~Renderer();
+
+	bool init(Display *dpy, const VKeyb *kb);
+	void resize(int w, int h);
+
+	/* the keyboard strip fills the window, frm_width is the fraction of the
+	 * window width the preview takes from the left
+	 */
+	void draw_strip(const VKeyb *kb);
+	void draw_preview(unsigned int tex, float frm_width);
+	void draw_overlay(const FrameSlot *slot, float frm_width);
+	/* x, y: baseline origin in window pixels from the bottom left corner */
+	void draw_text(int x, int y, const char *str);
+
+	/* draw cost accounting, from the start of display to the buffer swap */
+	void add_frame_time(unsigned long usec);
+	void print_stats(FILE *fp) const;
+};
+
+#endif	/* RENDER_H_ */
@@ -0,0 +1,141 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ring.h"
+
+SlotRing::SlotRing()
+{
+	num_glyphs = 0;
+	gen = 0;
+}
+
+void SlotRing::init(int num_glyphs)
+{
+	this->num_glyphs = num_glyphs;
+	preds.clear();
+	words.clear();
+	rebuild(-1);
+}
+
+int SlotRing::size() const
+{
+	return slots.size();
+}
+
+int SlotRing::glyph(int slot) const
+{
+	return slots[slot % slots.size()];
+}
+
+const char *SlotRing::word(int slot) const
+{
+	int idx = slots[slot % slots.size()];
+	return idx < 0 ? words[-1 - idx].c_str() : 0;
+}
+
+unsigned int SlotRing::generation() const
+{
+	return gen;
+}
+
+int SlotRing::set_completions(int active, const std::vector<std::string> &completions)
+{
+	int glyph = anchor_glyph(active);
+
+	if(completions == words) {
+		return active;
+	}
+	words = completions;
+	return rebuild(glyph);
+}
+
+int SlotRing::set_predictions(int active, const std::vector<int> &glyphs)
+{
+	int glyph = anchor_glyph(active);
+
+	if(glyphs == preds) {
+		return active;
+	}
+	preds = glyphs;
+	return rebuild(glyph);
+}
+
+int SlotRing::distance(int slot, int glyph) const
+{
+	int size = slots.size();
+
+	for(int i=0; i<=size / 2; i++) {
+		if(slots[(slot + i) % size] == glyph) {
+			return i;
+		}
+		if(slots[(slot + size - i) % size] == glyph) {
+			return -i;
+		}
+	}
+	return 0;
+}
+
+/* the glyph of slot, or the glyph the completions at slot follow. -1 if the
+ * ring holds no glyph at all.
+ */
+int SlotRing::anchor_glyph(int slot) const
+{
+	int size = slots.size();
+
+	for(int i=0; i<size; i++) {
+		int idx = slots[(slot + size - i) % size];
+		if(idx >= 0) {
+			return idx;
+		}
+	}
+	return -1;
+}
+
+int SlotRing::rebuild(int glyph)
+{
+	int anchor = 0;
+
+	slots.clear();
+	for(int i=0; i<num_glyphs; i++) {
+		if(i != glyph) {
+			slots.push_back(i);
+			continue;
+		}
+
+		/* a prediction of the anchor itself needs no slot, it's 0 steps away */
+		std::vector<int> near;
+		for(size_t j=0; j<preds.size(); j++) {
+			if(preds[j] != i) near.push_back(preds[j]);
+		}
+
+		/* odd predictions on the left, closest first */
+		for(int j=(int)near.size() - 1; j>=0; j--) {
+			if(j & 1) slots.push_back(near[j]);
+		}
+		anchor = slots.size();
+		slots.push_back(i);
+		for(size_t j=0; j<near.size(); j+=2) {
+			slots.push_back(near[j]);
+		}
+		for(size_t j=0; j<words.size(); j++) {
+			slots.push_back(-1 - (int)j);
+		}
+	}
+	gen++;
+	return anchor;
+}
@@ -0,0 +1,67 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <string>
+#include <vector>
+
+/* The ring of slots the keyboard strip scrolls through. Its base is every
+ * glyph once, in layout order. Around the anchor glyph (the active one when
+ * the extra slots were last set) it carries extra slots: predicted next
+ * glyphs, duplicated on alternating sides of the anchor so the likeliest is
+ * a single step away, followed by word completions. Slots hold glyph
+ * indices, and word completion i as -1 - i.
+ */
+class SlotRing {
+private:
+	int num_glyphs;
+	std::vector<int> slots;
+	std::vector<int> preds;
+	std::vector<std::string> words;
+	unsigned int gen;		/* changes whenever slots does */
+
+	int anchor_glyph(int slot) const;
+	int rebuild(int glyph);
+
+public:
+	SlotRing();
+
+	void init(int num_glyphs);
+
+	int size() const;
+	/* glyph of a slot (wrapping around), or -1 for a completion slot */
+	int glyph(int slot) const;
+	/* word of a completion slot, or null */
+	const char *word(int slot) const;
+	unsigned int generation() const;
+
+	/* Replace the extra slots around the glyph of the active slot, or the
+	 * glyph a completion slot follows. Return the slot that glyph ends up at.
+	 */
+	int set_completions(int active, const std::vector<std::string> &completions);
+	int set_predictions(int active, const std::vector<int> &glyphs);
+
+	/* signed steps from slot to the nearest slot holding glyph, 0 if there is
+	 * none
+	 */
+	int distance(int slot, int glyph) const;
+};
+
+#endif	/* RING_H_ */
@@ -0,0 +1,132 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include "scroll.h"
+
+ScrollCtl::ScrollCtl()
+{
+	alpha = 0.5;
+	beta = 0.1;
+	on_thres = 3.0;
+	off_thres = 1.5;
+	gain = 1.0;
+	max_speed = 20.0;
+	max_extrap = 150;
+
+	num_frames = num_sel = 0;
+	sel_frames = sel_msec = 0;
+	mark_frame = mark_msec = 0;
+	reset();
+}
+
+void ScrollCtl::update(double dir, unsigned long msec)
+{
+	if(!num_frames) {
+		mark_msec = msec;
+	}
+	num_frames++;
+
+	if(!have_meas) {
+		vel = dir;
+		trend = 0.0;
+		have_meas = true;
+	} else {
+		float dt = msec > last_msec ? msec - last_msec : 1;
+		float pred = vel + trend * dt;
+		float resid = dir - pred;
+
+		vel = pred + alpha * resid;
+		trend += beta * resid / dt;
+	}
+	last_msec = msec;
+
+	/* hysteresis against jitter around zero */
+	if(active) {
+		active = fabs(vel) >= off_thres;
+	} else {
+		active = fabs(vel) > on_thres;
+	}
+}
+
+float ScrollCtl::advance(unsigned long now)
+{
+	if(!last_advance || now < last_advance) {
+		last_advance = now;
+		return 0.0;
+	}
+
+	float dt = (now - last_advance) / 1000.0;
+	last_advance = now;
+
+	float speed = gain * velocity(now);
+	if(speed > max_speed) speed = max_speed;
+	if(speed < -max_speed) speed = -max_speed;
+
+	return speed * dt;
+}
+
+float ScrollCtl::velocity(unsigned long now) const
+{
+	if(!active) {
+		return 0.0;
+	}
+
+	unsigned long ahead = now > last_msec ? now - last_msec : 0;
+	if(ahead > max_extrap) {
+		ahead = max_extrap;
+	}
+
+	float v = vel + trend * ahead;
+	/* extrapolation may slow down scrolling, but never reverse it */
+	if(v * vel < 0.0) {
+		return 0.0;
+	}
+	return v;
+}
+
+bool ScrollCtl::scrolling() const
+{
+	return active;
+}
+
+void ScrollCtl::reset()
+{
+	vel = trend = 0.0;
+	have_meas = active = false;
+	last_msec = last_advance = 0;
+}
+
+void ScrollCtl::selected(unsigned long now)
+{
+	num_sel++;
+	sel_frames += num_frames - mark_frame;
+	sel_msec += now - mark_msec;
+	mark_frame = num_frames;
+	mark_msec = now;
+}
+
+void ScrollCtl::print_stats(FILE *fp) const
+{
+	if(!num_sel) {
+		fprintf(fp, "no glyphs selected\n");
+		return;
+	}
+	fprintf(fp, "selections: %lu, %.1f frames and %.0f ms per selection\n", num_sel,
+			(double)sel_frames / num_sel, (double)sel_msec / num_sel);
+}
@@ -0,0 +1,68 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCROLL_H_
+#define SCROLL_H_
+
+#include <stdio.h>
+
+/* Turns the per-frame motion direction into keyboard scrolling. The
+ * direction is smoothed with an alpha-beta filter, which also tracks its
+ * trend, and scrolling only starts once the filtered hand velocity clears an
+ * upper threshold and stops when it falls under a lower one. While active,
+ * the keyboard scrolls at a rate proportional to the hand velocity,
+ * extrapolated from the capture time of the last frame to the present to hide
+ * the latency of the capture pipeline.
+ */
+class ScrollCtl {
+private:
+	float vel;				/* filtered hand velocity, pixels per frame */
+	float trend;			/* its rate of change, per msec */
+	bool have_meas, active;
+	unsigned long last_msec;	/* capture time of the last measurement */
+	unsigned long last_advance;
+
+	unsigned long num_frames, num_sel;
+	unsigned long sel_frames, sel_msec;		/* totals over all selections */
+	unsigned long mark_frame, mark_msec;	/* at the previous selection */
+
+public:
+	float alpha, beta;		/* filter gains of the velocity and its trend */
+	float on_thres;			/* pixels per frame to start scrolling */
+	float off_thres;		/* pixels per frame under which scrolling stops */
+	float gain;				/* glyphs per second, per pixel per frame */
+	float max_speed;		/* glyphs per second */
+	unsigned long max_extrap;	/* msec to extrapolate at most */
+
+	ScrollCtl();
+
+	/* feeds the direction of a frame captured at msec */
+	void update(double dir, unsigned long msec);
+	/* returns the glyphs to scroll since the previous call */
+	float advance(unsigned long now);
+	/* predicted hand velocity at now, 0 unless scrolling */
+	float velocity(unsigned long now) const;
+	bool scrolling() const;
+	void reset();
+
+	/* records a glyph selection, for the frames/msec per selection stats */
+	void selected(unsigned long now);
+	void print_stats(FILE *fp) const;
+};
+
+#endif	/* SCROLL_H_ */
@@ -0,0 +1,126 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCQ_H_
+#define SPSCQ_H_
+
+#include <atomic>
+#include <pthread.h>
+
+/* Bounded single-producer/single-consumer queue. push and pop are lock-free,
+ * wait_pop sleeps on a condition variable while the queue is empty.
+ */
+template <typename T>
+class SPSCQueue {
+private:
+	T *items;
+	int nslots;					/* capacity + 1 */
+	std::atomic<int> head;		/* next slot to pop, owned by the consumer */
+	std::atomic<int> tail;		/* next slot to push, owned by the producer */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	SPSCQueue(const SPSCQueue&);
+	SPSCQueue &operator =(const SPSCQueue&);
+
+public:
+	SPSCQueue(int capacity);
+	~SPSCQueue();
+
+	/* returns false if the queue is full */
+	bool push(const T &item);
+	/* returns false if the queue is empty */
+	bool pop(T *item);
+	/* blocks until an item is available */
+	void wait_pop(T *item);
+
+	int size() const;
+};
+
+template <typename T>
+SPSCQueue<T>::SPSCQueue(int capacity)
+{
+	nslots = capacity + 1;
+	items = new T[nslots];
+	head = tail = 0;
+	pthread_mutex_init(&mutex, 0);
+	pthread_cond_init(&cond, 0);
+}
+
+template <typename T>
+SPSCQueue<T>::~SPSCQueue()
+{
+	delete [] items;
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&cond);
+}
+
+template <typename T>
+bool SPSCQueue<T>::push(const T &item)
+{
+	int t = tail.load(std::memory_order_relaxed);
+	int next = (t + 1) % nslots;
+
+	if(next == head.load(std::memory_order_acquire)) {
+		return false;
+	}
+	items[t] = item;
+	tail.store(next, std::memory_order_release);
+
+	/* taking the lock orders this wakeup after a consumer's empty check */
+	pthread_mutex_lock(&mutex);
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+	return true;
+}
+
+template <typename T>
+bool SPSCQueue<T>::pop(T *item)
+{
+	int h = head.load(std::memory_order_relaxed);
+
+	if(h == tail.load(std::memory_order_acquire)) {
+		return false;
+	}
+	*item = items[h];
+	head.store((h + 1) % nslots, std::memory_order_release);
+	return true;
+}
+
+template <typename T>
+void SPSCQueue<T>::wait_pop(T *item)
+{
+	if(pop(item)) {
+		return;
+	}
+
+	pthread_mutex_lock(&mutex);
+	while(!pop(item)) {
+		pthread_cond_wait(&cond, &mutex);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+template <typename T>
+int SPSCQueue<T>::size() const
+{
+	int n = tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	return n < 0 ? n + nslots : n;
+}
+
+#endif	/* SPSCQ_H_ */
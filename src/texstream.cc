@@ -0,0 +1,146 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define GL_GLEXT_PROTOTYPES
+#include <string.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "texstream.h"
+#include "timer.h"
+
+TexStream::TexStream()
+{
+	tex = 0;
+	memset(pbo, 0, sizeof pbo);
+	cur = 0;
+	width = height = type = 0;
+	size = 0;
+	num_uploads = num_bytes = 0;
+	upload_usec = max_usec = 0;
+}
+
+TexStream::~TexStream()
+{
+	if(pbo[0]) {
+		glDeleteBuffers(TEXSTREAM_PBOS, pbo);
+	}
+	if(tex) {
+		glDeleteTextures(1, &tex);
+	}
+}
+
+bool TexStream::init()
+{
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+	glGenBuffers(TEXSTREAM_PBOS, pbo);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+bool TexStream::upload(const cv::Mat &img)
+{
+	unsigned int fmt, pixtype;
+
+	switch(img.type()) {
+	case CV_8UC2:
+		fmt = GL_RGB;
+		pixtype = GL_UNSIGNED_SHORT_5_6_5;
+		break;
+	case CV_8UC3:
+		fmt = GL_BGR;
+		pixtype = GL_UNSIGNED_BYTE;
+		break;
+	default:
+		fprintf(stderr, "TexStream: unsupported image type: %d\n", img.type());
+		return false;
+	}
+
+	uint64_t t0 = get_usec();
+	size_t row_size = img.cols * img.elemSize();
+
+	glBindTexture(GL_TEXTURE_2D, tex);
+
+	if(img.cols != width || img.rows != height || img.type() != type) {
+		width = img.cols;
+		height = img.rows;
+		type = img.type();
+		size = row_size * height;
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, fmt, pixtype, 0);
+		for(int i=0; i<TEXSTREAM_PBOS; i++) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW);
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[cur]);
+	/* orphan the old storage, in case its transfer is still in flight */
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW);
+
+	unsigned char *dest = (unsigned char*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	if(!dest) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		fprintf(stderr, "TexStream: failed to map pixel buffer\n");
+		return false;
+	}
+	if(img.isContinuous()) {
+		memcpy(dest, img.ptr(), size);
+	} else {
+		for(int i=0; i<height; i++) {
+			memcpy(dest + i * row_size, img.ptr(i), row_size);
+		}
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	/* rows are packed, and RGB565 rows of odd widths aren't 4 byte aligned */
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, fmt, pixtype, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	cur = (cur + 1) % TEXSTREAM_PBOS;
+
+	unsigned long dt = get_usec() - t0;
+	num_uploads++;
+	num_bytes += size;
+	upload_usec += dt;
+	if(dt > max_usec) {
+		max_usec = dt;
+	}
+	return true;
+}
+
+unsigned int TexStream::texture() const
+{
+	return tex;
+}
+
+void TexStream::print_stats(FILE *fp) const
+{
+	if(num_uploads) {
+		fprintf(fp, "preview: %lu uploads of %dx%d, %.1f KB/upload, %.3f ms/upload (max %.3f ms)\n",
+				num_uploads, width, height, num_bytes / 1024.0 / num_uploads,
+				upload_usec / 1000.0 / num_uploads, max_usec / 1000.0);
+	}
+}
@@ -0,0 +1,59 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEXSTREAM_H_
+#define TEXSTREAM_H_
+
+#include <stdio.h>
+#include <opencv2/opencv.hpp>
+
+#define TEXSTREAM_PBOS	2
+
+/* Streams images into a texture through a pair of pixel buffer objects. Each
+ * upload copies the image into the buffer which wasn't used by the previous
+ * upload, so the copy never waits for the previous transfer to the texture to
+ * complete, and the transfer itself runs asynchronously to the CPU. Takes
+ * RGB565 images (CV_8UC2, see the preview of FrameSlot) or BGR images.
+ */
+class TexStream {
+private:
+	unsigned int tex;
+	unsigned int pbo[TEXSTREAM_PBOS];
+	int cur;			/* buffer of the next upload */
+	int width, height, type;
+	size_t size;		/* bytes per buffer */
+
+	unsigned long num_uploads, num_bytes;
+	unsigned long upload_usec, max_usec;
+
+public:
+	TexStream();
+	~TexStream();
+
+	bool init();
+	/* (re)allocates the texture and the buffers when the image size or type
+	 * changes
+	 */
+	bool upload(const cv::Mat &img);
+
+	unsigned int texture() const;
+
+	void print_stats(FILE *fp) const;
+};
+
+#endif	/* TEXSTREAM_H_ */
@@ -0,0 +1,49 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include <unistd.h>
+#include "timer.h"
+
+static uint64_t clock_usec();
+
+/* initialized before main, while there is only one thread */
+static uint64_t start_usec = clock_usec();
+
+static uint64_t clock_usec()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+unsigned long get_msec()
+{
+	return get_usec() / 1000;
+}
+
+uint64_t get_usec()
+{
+	return clock_usec() - start_usec;
+}
+
+void sleep_msec(unsigned long msec)
+{
+	usleep(msec * 1000);
+}
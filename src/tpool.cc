@@ -0,0 +1,192 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "tpool.h"
+
+ThreadPool::ThreadPool(int threads)
+{
+	if(threads <= 0) {
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if(threads <= 0) threads = 1;
+	}
+
+	pthread_mutex_init(&mutex, 0);
+	pthread_cond_init(&work_cond, 0);
+	pthread_cond_init(&done_cond, 0);
+	batch = 0;
+	quit = false;
+	func = 0;
+	arg = 0;
+	pending = 0;
+
+	num_workers = threads - 1;
+	workers = new Worker[num_workers > 0 ? num_workers : 1];
+
+	for(int i=0; i<num_workers; i++) {
+		Worker *w = workers + i;
+		int res;
+
+		w->pool = this;
+		w->idx = i;
+		pthread_mutex_init(&w->lock, 0);
+		if((res = pthread_create(&w->td, 0, worker_thread, w)) != 0) {
+			fprintf(stderr, "failed to create worker thread: %s\n", strerror(res));
+			pthread_mutex_destroy(&w->lock);
+			num_workers = i;
+			break;
+		}
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	pthread_mutex_lock(&mutex);
+	quit = true;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&mutex);
+
+	for(int i=0; i<num_workers; i++) {
+		pthread_join(workers[i].td, 0);
+		pthread_mutex_destroy(&workers[i].lock);
+	}
+	delete [] workers;
+
+	pthread_cond_destroy(&done_cond);
+	pthread_cond_destroy(&work_cond);
+	pthread_mutex_destroy(&mutex);
+}
+
+void ThreadPool::parallel_for(int count, void (*func)(int, void*), void *arg)
+{
+	if(count <= 0) {
+		return;
+	}
+	if(!num_workers) {
+		for(int i=0; i<count; i++) {
+			func(i, arg);
+		}
+		return;
+	}
+
+	/* no worker can pop a task before it's queued, and the job is set up
+	 * before that
+	 */
+	this->func = func;
+	this->arg = arg;
+	pending = count;
+
+	for(int i=0; i<num_workers; i++) {
+		Worker *w = workers + i;
+
+		pthread_mutex_lock(&w->lock);
+		for(int j=i; j<count; j+=num_workers) {
+			w->tasks.push_back(j);
+		}
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	pthread_mutex_lock(&mutex);
+	batch++;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&mutex);
+
+	/* help out instead of just waiting */
+	while(run_task(-1));
+
+	pthread_mutex_lock(&mutex);
+	while(pending > 0) {
+		pthread_cond_wait(&done_cond, &mutex);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+int ThreadPool::num_threads() const
+{
+	return num_workers + 1;
+}
+
+/* runs one task of the current batch: the newest of worker self if it has
+ * any, otherwise the oldest of another worker. Returns false if there are no
+ * tasks left to take.
+ */
+bool ThreadPool::run_task(int self)
+{
+	int task = -1;
+
+	if(self >= 0) {
+		Worker *w = workers + self;
+
+		pthread_mutex_lock(&w->lock);
+		if(!w->tasks.empty()) {
+			task = w->tasks.back();
+			w->tasks.pop_back();
+		}
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	for(int i=1; task == -1 && i<=num_workers; i++) {
+		Worker *victim = workers + (self + i + num_workers) % num_workers;
+		if(victim - workers == self) continue;
+
+		pthread_mutex_lock(&victim->lock);
+		if(!victim->tasks.empty()) {
+			task = victim->tasks.front();
+			victim->tasks.pop_front();
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+
+	if(task == -1) {
+		return false;
+	}
+
+	func(task, arg);
+
+	if(--pending == 0) {
+		pthread_mutex_lock(&mutex);
+		pthread_cond_signal(&done_cond);
+		pthread_mutex_unlock(&mutex);
+	}
+	return true;
+}
+
+void *ThreadPool::worker_thread(void *arg)
+{
+	Worker *w = (Worker*)arg;
+	ThreadPool *pool = w->pool;
+	unsigned long seen = 0;
+
+	for(;;) {
+		pthread_mutex_lock(&pool->mutex);
+		while(pool->batch == seen && !pool->quit) {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		}
+		if(pool->quit) {
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+		seen = pool->batch;
+		pthread_mutex_unlock(&pool->mutex);
+
+		while(pool->run_task(w->idx));
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TPOOL_H_
+#define TPOOL_H_
+
+#include <atomic>
+#include <deque>
+#include <pthread.h>
+
+/* Fork-join thread pool with work stealing. parallel_for deals the task
+ * indices out round-robin into per-worker deques. Every worker runs its own
+ * tasks newest first, and when it runs out, steals the oldest tasks of the
+ * others, so uneven tasks still keep all threads busy. The calling thread
+ * steals tasks too, until the whole batch is done.
+ */
+class ThreadPool {
+private:
+	struct Worker {
+		ThreadPool *pool;
+		int idx;
+		pthread_t td;
+		pthread_mutex_t lock;
+		std::deque<int> tasks;
+	};
+
+	Worker *workers;
+	int num_workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond, done_cond;
+	unsigned long batch;		/* incremented for every parallel_for */
+	bool quit;
+
+	void (*func)(int, void*);
+	void *arg;
+	std::atomic<int> pending;	/* tasks of the batch not finished yet */
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool &operator =(const ThreadPool&);
+
+	bool run_task(int self);
+	static void *worker_thread(void *arg);
+
+public:
+	/* threads counts the calling thread; 0 means one per online CPU */
+	ThreadPool(int threads = 0);
+	~ThreadPool();
+
+	/* calls func(i, arg) for every i in [0, count) in parallel, and returns
+	 * when all calls have returned
+	 */
+	void parallel_for(int count, void (*func)(int, void*), void *arg);
+
+	int num_threads() const;
+};
+
+#endif	/* TPOOL_H_ */
@@ -0,0 +1,277 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include "tracker.h"
+
+static void drop_masked(const cv::Mat &mask, std::vector<cv::Point2f> &from,
+		std::vector<cv::Point2f> &to);
+
+FeatureTracker::FeatureTracker()
+{
+	max_features = 400;
+	min_features = 100;
+	detect_interval = 30;
+	quality = 0.01;
+	min_dist = 3.0;
+	pyr_levels = 3;
+	win_size = 21;
+	tiles_x = tiles_y = 1;
+	pool = 0;
+
+	for(int i=0; i<2; i++) {
+		ring[i].levels = 0;
+		ring[i].valid = false;
+	}
+	cur = 0;
+	frames_since_detect = 0;
+	num_frames = num_detect = 0;
+}
+
+void FeatureTracker::reset()
+{
+	ring[0].valid = ring[1].valid = false;
+	points.clear();
+	frames_since_detect = 0;
+}
+
+bool FeatureTracker::track(const cv::Mat &frm, std::vector<cv::Point2f> &from, std::vector<cv::Point2f> &to,
+		const cv::Mat &mask)
+{
+	from.clear();
+	to.clear();
+	num_frames++;
+
+	TrackFrame *prev = ring + cur;
+	TrackFrame *next = ring + (cur ^ 1);
+	cv::Size win(win_size, win_size);
+
+	/* build the pyramid of the new frame exactly once, into the ring entry
+	 * of the frame before the previous one so that its buffers are reused.
+	 * Never let level 0 alias frm, the caller overwrites it next frame.
+	 */
+	next->levels = cv::buildOpticalFlowPyramid(frm, next->pyr, win, pyr_levels, true,
+			cv::BORDER_REFLECT_101, cv::BORDER_CONSTANT, false);
+	next->valid = true;
+	cur ^= 1;
+
+	if(!prev->valid || prev->pyr[0].size() != frm.size()) {
+		detect(next->pyr[0], mask);
+		return false;
+	}
+
+	if(!points.empty() && tiles_x * tiles_y > 1) {
+		track_tiled(prev, next, std::min(prev->levels, next->levels), from, to);
+	} else if(!points.empty()) {
+		int levels = std::min(prev->levels, next->levels);
+		cv::calcOpticalFlowPyrLK(prev->pyr, next->pyr, points, next_points, status, err,
+				win, levels);
+
+		for(size_t i=0; i<status.size(); i++) {
+			if(!status[i])
+				continue;
+
+			from.push_back(points[i]);
+			to.push_back(next_points[i]);
+		}
+	}
+
+	/* tracks which wandered off the mask stop counting right away, instead
+	 * of at the next detection
+	 */
+	if(!mask.empty()) {
+		drop_masked(mask, from, to);
+	}
+	/* the surviving tracks continue from their new positions */
+	points = to;
+
+	frames_since_detect++;
+	if((int)points.size() < min_features ||
+			(detect_interval > 0 && frames_since_detect >= detect_interval)) {
+		detect(next->pyr[0], mask);
+	}
+	return true;
+}
+
+void FeatureTracker::detect(const cv::Mat &frm, const cv::Mat &mask)
+{
+	if(tiles_x * tiles_y > 1) {
+		detect_tiled(frm, mask);
+	} else {
+		cv::goodFeaturesToTrack(frm, points, max_features, quality, min_dist, mask);
+	}
+	frames_since_detect = 0;
+	num_detect++;
+}
+
+void FeatureTracker::layout_tiles(cv::Size size)
+{
+	int ntiles = tiles_x * tiles_y;
+
+	if((int)tiles.size() == ntiles && tiles.back().rect.br() == cv::Point(size.width, size.height)) {
+		return;
+	}
+
+	tiles.resize(ntiles);
+	for(int i=0; i<tiles_y; i++) {
+		int y0 = size.height * i / tiles_y;
+		int y1 = size.height * (i + 1) / tiles_y;
+
+		for(int j=0; j<tiles_x; j++) {
+			int x0 = size.width * j / tiles_x;
+			int x1 = size.width * (j + 1) / tiles_x;
+
+			tiles[i * tiles_x + j].rect = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+		}
+	}
+}
+
+void FeatureTracker::track_tiled(const TrackFrame *prev, const TrackFrame *next, int levels,
+		std::vector<cv::Point2f> &from, std::vector<cv::Point2f> &to)
+{
+	cv::Size size = next->pyr[0].size();
+	layout_tiles(size);
+
+	/* hand every point to the tile it's in, keeping their order */
+	for(size_t i=0; i<tiles.size(); i++) {
+		tiles[i].points.clear();
+	}
+	for(size_t i=0; i<points.size(); i++) {
+		int tx = (int)points[i].x * tiles_x / size.width;
+		int ty = (int)points[i].y * tiles_y / size.height;
+		tx = std::max(0, std::min(tx, tiles_x - 1));
+		ty = std::max(0, std::min(ty, tiles_y - 1));
+
+		tiles[ty * tiles_x + tx].points.push_back(points[i]);
+	}
+
+	job_prev = prev;
+	job_next = next;
+	job_levels = levels;
+	if(pool) {
+		pool->parallel_for(tiles.size(), track_tile, this);
+	} else {
+		for(size_t i=0; i<tiles.size(); i++) {
+			track_tile(i, this);
+		}
+	}
+
+	for(size_t i=0; i<tiles.size(); i++) {
+		from.insert(from.end(), tiles[i].from.begin(), tiles[i].from.end());
+		to.insert(to.end(), tiles[i].to.begin(), tiles[i].to.end());
+	}
+}
+
+void FeatureTracker::track_tile(int idx, void *arg)
+{
+	FeatureTracker *tr = (FeatureTracker*)arg;
+	TrackTile *tile = &tr->tiles[idx];
+
+	tile->from.clear();
+	tile->to.clear();
+	if(tile->points.empty()) {
+		return;
+	}
+
+	/* the pyramids are shared, and only read */
+	cv::calcOpticalFlowPyrLK(tr->job_prev->pyr, tr->job_next->pyr, tile->points,
+			tile->next_points, tile->status, tile->err, cv::Size(tr->win_size, tr->win_size),
+			tr->job_levels);
+
+	for(size_t i=0; i<tile->status.size(); i++) {
+		if(!tile->status[i])
+			continue;
+
+		tile->from.push_back(tile->points[i]);
+		tile->to.push_back(tile->next_points[i]);
+	}
+}
+
+void FeatureTracker::detect_tiled(const cv::Mat &frm, const cv::Mat &mask)
+{
+	layout_tiles(frm.size());
+
+	job_frm = &frm;
+	job_mask = &mask;
+	if(pool) {
+		pool->parallel_for(tiles.size(), detect_tile, this);
+	} else {
+		for(size_t i=0; i<tiles.size(); i++) {
+			detect_tile(i, this);
+		}
+	}
+
+	points.clear();
+	for(size_t i=0; i<tiles.size(); i++) {
+		points.insert(points.end(), tiles[i].points.begin(), tiles[i].points.end());
+	}
+}
+
+void FeatureTracker::detect_tile(int idx, void *arg)
+{
+	FeatureTracker *tr = (FeatureTracker*)arg;
+	TrackTile *tile = &tr->tiles[idx];
+	const cv::Mat &frm = *tr->job_frm;
+	int ntiles = tr->tiles.size();
+	int quota = (tr->max_features + ntiles - 1) / ntiles;
+
+	cv::Mat tmask;
+	if(!tr->job_mask->empty()) {
+		tmask = (*tr->job_mask)(tile->rect);
+	}
+	cv::goodFeaturesToTrack(frm(tile->rect), tile->points, quota, tr->quality, tr->min_dist, tmask);
+
+	for(size_t i=0; i<tile->points.size(); i++) {
+		tile->points[i].x += tile->rect.x;
+		tile->points[i].y += tile->rect.y;
+	}
+}
+
+int FeatureTracker::num_points() const
+{
+	return (int)points.size();
+}
+
+unsigned long FeatureTracker::frames() const
+{
+	return num_frames;
+}
+
+unsigned long FeatureTracker::detections() const
+{
+	return num_detect;
+}
+
+static void drop_masked(const cv::Mat &mask, std::vector<cv::Point2f> &from,
+		std::vector<cv::Point2f> &to)
+{
+	size_t num = 0;
+
+	for(size_t i=0; i<to.size(); i++) {
+		int x = (int)(to[i].x + 0.5);
+		int y = (int)(to[i].y + 0.5);
+
+		if(x < 0 || y < 0 || x >= mask.cols || y >= mask.rows || !mask.at<unsigned char>(y, x)) {
+			continue;
+		}
+		from[num] = from[i];
+		to[num++] = to[i];
+	}
+	from.resize(num);
+	to.resize(num);
+}
@@ -0,0 +1,106 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACKER_H_
+#define TRACKER_H_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "tpool.h"
+
+/* a frame of the tracker ring: the optical flow pyramid, built once per
+ * frame and used both as the "next" and then as the "previous" pyramid.
+ * Level 0 of the pyramid is the frame itself.
+ */
+struct TrackFrame {
+	std::vector<cv::Mat> pyr;
+	int levels;
+	bool valid;
+};
+
+/* per tile state of the tiled tracker */
+struct TrackTile {
+	cv::Rect rect;
+	std::vector<cv::Point2f> points, next_points;
+	std::vector<cv::Point2f> from, to;
+	std::vector<unsigned char> status;
+	std::vector<float> err;
+};
+
+/* KLT feature tracker which carries its points from frame to frame, and only
+ * runs corner detection when too few tracks survive or every detect_interval
+ * frames.
+ */
+class FeatureTracker {
+private:
+	TrackFrame ring[2];
+	int cur;				/* ring index of the last frame */
+	std::vector<cv::Point2f> points, next_points;
+	std::vector<unsigned char> status;
+	std::vector<float> err;
+	int frames_since_detect;
+	unsigned long num_frames, num_detect;
+
+	/* tiled mode, see tiles_x/tiles_y */
+	std::vector<TrackTile> tiles;
+	const TrackFrame *job_prev, *job_next;
+	const cv::Mat *job_frm, *job_mask;
+	int job_levels;
+
+	void detect(const cv::Mat &frm, const cv::Mat &mask);
+	void layout_tiles(cv::Size size);
+	void track_tiled(const TrackFrame *prev, const TrackFrame *next, int levels,
+			std::vector<cv::Point2f> &from, std::vector<cv::Point2f> &to);
+	void detect_tiled(const cv::Mat &frm, const cv::Mat &mask);
+	static void track_tile(int idx, void *arg);
+	static void detect_tile(int idx, void *arg);
+
+public:
+	int max_features;
+	int min_features;		/* re-detect when fewer tracks than this survive */
+	int detect_interval;	/* re-detect at least this often (0: never) */
+	double quality;
+	double min_dist;
+	int pyr_levels;			/* max pyramid level (0: no pyramid) */
+	int win_size;			/* LK search window size */
+	/* With more than one tile, the frame is split into a grid, every tile
+	 * detects up to its share of max_features, and tiles are detected and
+	 * tracked in parallel on pool (serially if null). The results are merged
+	 * in tile order, so they don't depend on the number of threads.
+	 */
+	int tiles_x, tiles_y;
+	ThreadPool *pool;
+
+	FeatureTracker();
+
+	/* tracks the current points from the previous frame into frm, and returns
+	 * the surviving tracks as pairs of start/end points. Returns false if
+	 * there was no previous frame to track from. If mask isn't empty, new
+	 * corners are only detected where it's non-zero, and tracks ending
+	 * where it's zero are dropped.
+	 */
+	bool track(const cv::Mat &frm, std::vector<cv::Point2f> &from, std::vector<cv::Point2f> &to,
+			const cv::Mat &mask = cv::Mat());
+	void reset();
+
+	int num_points() const;
+	unsigned long frames() const;
+	unsigned long detections() const;
+};
+
+#endif	/* TRACKER_H_ */
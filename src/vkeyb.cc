@@ -19,50 +19,59 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <math.h>
 #include <GL/gl.h>
-#include <X11/keysym.h>
-#include <imago2.h>
 #include "vkeyb.h"
+#include "atlas.h"
+#include "cache.h"
+#include "timer.h"
 
-static KeySym charmap[] = {
-	XK_Greek_ALPHA,
-	XK_Greek_BETA,
-	XK_Greek_GAMMA,
-	XK_Greek_DELTA,
-	XK_Greek_EPSILON,
-	XK_Greek_ZETA,
-	XK_Greek_ETA,
-	XK_Greek_THETA,
-	XK_Greek_IOTA,
-	XK_Greek_KAPPA,
-	XK_Greek_LAMBDA,
-	XK_Greek_MU,
-	XK_Greek_NU,
-	XK_Greek_XI,
-	XK_Greek_OMICRON,
-	XK_Greek_PI,
-	XK_Greek_RHO,
-	XK_Greek_SIGMA,
-	XK_Greek_TAU,
-	XK_Greek_UPSILON,
-	XK_Greek_PHI,
-	XK_Greek_CHI,
-	XK_Greek_PSI,
-	XK_Greek_OMEGA,
-	' ', '\b', '\n',
-	'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
-	'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z'
-};
-
-static unsigned int load_texture(const char *fname);
-
-VKeyb::VKeyb()
+#define VISIBLE_GLYPHS	24
+
+static unsigned int load_texture(const AtlasFile *atlas);
+
+/* maps the atlas cached for the layout, building it first if there is none.
+ * If it can't be cached, the atlas built in memory does for this run.
+ */
+VKeyb::VKeyb(Display *dpy, const char *layout, const char *font)
 {
+	std::vector<LayoutKey> lkeys;
+	std::vector<unsigned char> buf;
+	uint64_t hash;
+	AtlasFile atlas;
+	std::string fname;
+	uint64_t t0 = get_usec();
+
 	offset = 0;
-	if(!(tex = load_texture("data/glyphs.png"))) {
+	if(!load_layout(layout, font, &lkeys, &hash)) {
+		throw 1;
+	}
+	bool cached = cache_path("atlas", hash, &fname);
+
+	if(!cached || !atlas.open(fname.c_str(), hash)) {
+		printf("building glyph atlas of %s\n", layout);
+		if(!build_atlas(dpy, font, lkeys, hash, &buf)) {
+			throw 1;
+		}
+		if(!cached || !write_cache(fname.c_str(), &buf[0], buf.size()) ||
+				!atlas.open(fname.c_str(), hash)) {
+			fprintf(stderr, "glyph atlas not cached, keeping it in memory\n");
+			if(!atlas.open(&buf, hash)) {
+				throw 1;
+			}
+		}
+	}
+
+	num_glyphs = atlas.num_glyphs();
+	visible_glyphs = num_glyphs < VISIBLE_GLYPHS ? num_glyphs : VISIBLE_GLYPHS;
+	for(int i=0; i<num_glyphs; i++) {
+		keys.push_back(atlas.keysym(i));
+	}
+	ring.init(num_glyphs);
+
+	if(!(tex = load_texture(&atlas))) {
 		throw 1;
 	}
-	num_glyphs = 53;
-	visible_glyphs = 24;
+	printf("glyph atlas: %d glyphs, %d levels, loaded in %.3f ms\n", num_glyphs,
+			atlas.num_levels(), (get_usec() - t0) / 1000.0);
 }
 
 VKeyb::~VKeyb()
@@ -70,86 +79,128 @@ VKeyb::~VKeyb()
 	glDeleteTextures(1, &tex);
 }
 
-void VKeyb::show() const
+void VKeyb::move(float offs)
 {
-	float uoffs = floor(offset) / num_glyphs;
-	float umax = (float)visible_glyphs / num_glyphs;
-
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, tex);
-
-	glBegin(GL_QUADS);
-	glColor3f(1, 1, 1);
-	glTexCoord2f(uoffs, 1);
-	glVertex2f(-1, -1);
-	glTexCoord2f(uoffs + umax, 1);
-	glVertex2f(1, -1);
-	glTexCoord2f(uoffs + umax, 0);
-	glVertex2f(1, 1);
-	glTexCoord2f(uoffs, 0);
-	glVertex2f(-1, 1);
-	glEnd();
+	float tmp = offset + offs;
 
-	glDisable(GL_TEXTURE_2D);
+	int size = ring.size();
 
-	float rect_width = 2.0 / visible_glyphs;
+	if(tmp < 0.0) {
+		offset = fmod(size + fmod(tmp, size), size);
+	} else {
+		offset = fmod(tmp, size);
+	}
+}
 
-	glLineWidth(2.0);
-	glBegin(GL_LINE_LOOP);
-	glColor3f(1, 0, 0);
-	glVertex2f(0, -1);
-	glVertex2f(rect_width, -1);
-	glVertex2f(rect_width, 1);
-	glVertex2f(0, 1);
-	glEnd();
+void VKeyb::set_completions(const std::vector<std::string> &completions)
+{
+	set_active(ring.set_completions(active_slot(), completions));
 }
 
-void VKeyb::move(float offs)
+void VKeyb::set_predictions(const std::vector<int> &glyphs)
 {
-	float tmp = offset + offs;
+	set_active(ring.set_predictions(active_slot(), glyphs));
+}
 
-	if(tmp < 0.0) {
-		offset = fmod(num_glyphs + tmp, num_glyphs);
-	} else {
-		offset = fmod(tmp, num_glyphs);
-	}
+/* scrolls slot under the selection, keeping the fraction of a slot scrolled */
+void VKeyb::set_active(int slot)
+{
+	float frac = offset - floor(offset);
+	offset = 0;
+	move(slot - visible_glyphs / 2 + frac);
 }
 
 
-static unsigned int load_texture(const char *fname)
+/* uploads the mipmap chain straight from the mapping */
+static unsigned int load_texture(const AtlasFile *atlas)
 {
-	void *pixels;
-	int xsz, ysz;
 	unsigned int tex;
-
-	if(!(pixels = img_load_pixels(fname, &xsz, &ysz, IMG_FMT_RGBA32))) {
-		fprintf(stderr, "failed to load image: %s\n", fname);
-		return 0;
-	}
+	int levels = atlas->num_levels();
 
 	glGenTextures(1, &tex);
 	glBindTexture(GL_TEXTURE_2D, tex);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, xsz, ysz, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	for(int i=0; i<levels; i++) {
+		int xsz, ysz;
+		const unsigned char *pixels = atlas->level(i, &xsz, &ysz);
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, xsz, ysz, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
 
 	if(glGetError() != GL_NO_ERROR) {
-		img_free_pixels(pixels);
+		fprintf(stderr, "failed to create the glyph atlas texture\n");
+		glDeleteTextures(1, &tex);
 		return 0;
 	}
+	return tex;
+}
 
-	img_free_pixels(pixels);
+unsigned int VKeyb::texture() const
+{
 	return tex;
 }
 
-int VKeyb::active_glyph() const
+int VKeyb::glyph_count() const
+{
+	return num_glyphs;
+}
+
+int VKeyb::find_glyph(KeySym sym) const
+{
+	for(int i=0; i<num_glyphs; i++) {
+		if(keys[i] == sym) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int VKeyb::num_visible() const
+{
+	return visible_glyphs;
+}
+
+int VKeyb::num_slots() const
+{
+	return ring.size();
+}
+
+float VKeyb::first_visible() const
 {
-	return (int)(offset + visible_glyphs / 2) % num_glyphs;
+	return offset;
+}
+
+int VKeyb::slot_glyph(int slot) const
+{
+	return ring.glyph(slot);
+}
+
+const char *VKeyb::slot_word(int slot) const
+{
+	return ring.word(slot);
+}
+
+unsigned int VKeyb::generation() const
+{
+	return ring.generation();
+}
+
+int VKeyb::active_slot() const
+{
+	return (int)(offset + visible_glyphs / 2) % ring.size();
 }
 
 KeySym VKeyb::active_key() const
 {
-	return charmap[active_glyph()];
+	int idx = ring.glyph(active_slot());
+	return idx < 0 ? NoSymbol : keys[idx];
+}
+
+const char *VKeyb::active_word() const
+{
+	return slot_word(active_slot());
 }
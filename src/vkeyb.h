@@ -19,24 +19,56 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef VKEYB_H_
 #define VKEYB_H_
 
+#include <string>
+#include <vector>
 #include <X11/Xlib.h>
+#include "ring.h"
 
 class VKeyb {
 private:
 	int num_glyphs;
 	int visible_glyphs;
-	float offset;
+	float offset;			/* of the first visible slot, in slots */
 	unsigned int tex;
+	std::vector<KeySym> keys;	/* of the glyphs, in layout order */
+
+	SlotRing ring;
+
+	void set_active(int slot);
 
 public:
-	VKeyb();
+	/* layout: layout file (see load_layout), font: X core font of the labels */
+	VKeyb(Display *dpy, const char *layout, const char *font);
 	~VKeyb();
 
-	void show() const;
 	void move(float offs);
+	/* replace the completion or predicted glyph slots, keeping the active
+	 * glyph in place
+	 */
+	void set_completions(const std::vector<std::string> &completions);
+	void set_predictions(const std::vector<int> &glyphs);
+
+	/* glyph atlas texture, glyph i is the i-th of glyph_count() equal cells */
+	unsigned int texture() const;
+	int glyph_count() const;
+	/* glyph of a keysym, or -1 if it's not on the keyboard */
+	int find_glyph(KeySym sym) const;
+
+	int num_visible() const;
+	int num_slots() const;
+	/* the slot at the left edge, and the fraction of it scrolled past */
+	float first_visible() const;
+	/* glyph of a slot, or -1 for a completion slot */
+	int slot_glyph(int slot) const;
+	/* word of a completion slot, or null for a glyph slot */
+	const char *slot_word(int slot) const;
+	unsigned int generation() const;
 
-	int active_glyph() const;
+	int active_slot() const;
+	/* keysym of the active glyph, NoSymbol if a completion is active */
 	KeySym active_key() const;
+	/* the active completion, or null */
+	const char *active_word() const;
 };
 
 #endif
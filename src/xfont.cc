@@ -0,0 +1,115 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xutil.h>
+#include "xfont.h"
+
+#define ATLAS_COLUMNS	16
+
+bool xfont_atlas(Display *dpy, const char *name, XFontAtlas *atlas)
+{
+	XFontStruct *font;
+
+	if(!(font = XLoadQueryFont(dpy, name))) {
+		fprintf(stderr, "failed to load font: %s\n", name);
+		return false;
+	}
+
+	/* one cell per glyph, big enough for any of them */
+	int cell_w = font->max_bounds.rbearing - font->min_bounds.lbearing;
+	int cell_h = font->max_bounds.ascent + font->max_bounds.descent;
+	int rows = (XFONT_NUM_CHARS + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+
+	atlas->width = cell_w * ATLAS_COLUMNS;
+	atlas->height = cell_h * rows;
+	atlas->ascent = font->ascent;
+	atlas->descent = font->descent;
+
+	Window root = DefaultRootWindow(dpy);
+	int depth = DefaultDepth(dpy, DefaultScreen(dpy));
+	Pixmap pix = XCreatePixmap(dpy, root, atlas->width, atlas->height, depth);
+
+	XGCValues gcv;
+	gcv.font = font->fid;
+	gcv.foreground = BlackPixel(dpy, DefaultScreen(dpy));
+	GC gc = XCreateGC(dpy, pix, GCFont | GCForeground, &gcv);
+	XFillRectangle(dpy, pix, gc, 0, 0, atlas->width, atlas->height);
+	XSetForeground(dpy, gc, WhitePixel(dpy, DefaultScreen(dpy)));
+
+	for(int i=0; i<XFONT_NUM_CHARS; i++) {
+		char c = XFONT_FIRST_CHAR + i;
+		int cx = (i % ATLAS_COLUMNS) * cell_w;
+		int cy = (i / ATLAS_COLUMNS) * cell_h;
+		XCharStruct cs;
+		int dir, asc, desc;
+
+		XTextExtents(font, &c, 1, &dir, &asc, &desc, &cs);
+
+		/* origin placed so that the ink starts at the cell corner */
+		XDrawString(dpy, pix, gc, cx - font->min_bounds.lbearing, cy + font->max_bounds.ascent, &c, 1);
+
+		XFontGlyph *g = atlas->glyph + i;
+		g->x = cx + cs.lbearing - font->min_bounds.lbearing;
+		g->y = cy + font->max_bounds.ascent - cs.ascent;
+		g->width = cs.rbearing - cs.lbearing;
+		g->height = cs.ascent + cs.descent;
+		g->advance = cs.width;
+		g->left = cs.lbearing;
+		g->top = cs.ascent;
+	}
+
+	XImage *img = XGetImage(dpy, pix, 0, 0, atlas->width, atlas->height, AllPlanes, ZPixmap);
+	if(!img) {
+		fprintf(stderr, "failed to read back the font atlas\n");
+		XFreeGC(dpy, gc);
+		XFreePixmap(dpy, pix);
+		XFreeFont(dpy, font);
+		return false;
+	}
+	if(!(atlas->pixels = (unsigned char*)malloc(atlas->width * atlas->height))) {
+		fprintf(stderr, "failed to allocate font atlas\n");
+		XDestroyImage(img);
+		XFreeGC(dpy, gc);
+		XFreePixmap(dpy, pix);
+		XFreeFont(dpy, font);
+		return false;
+	}
+
+	unsigned long black = BlackPixel(dpy, DefaultScreen(dpy));
+	for(int i=0; i<atlas->height; i++) {
+		unsigned char *row = atlas->pixels + i * atlas->width;
+		for(int j=0; j<atlas->width; j++) {
+			row[j] = XGetPixel(img, j, i) != black ? 255 : 0;
+		}
+	}
+
+	XDestroyImage(img);
+	XFreeGC(dpy, gc);
+	XFreePixmap(dpy, pix);
+	XFreeFont(dpy, font);
+	return true;
+}
+
+void xfont_free(XFontAtlas *atlas)
+{
+	free(atlas->pixels);
+	atlas->pixels = 0;
+}
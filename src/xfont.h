@@ -0,0 +1,48 @@
+/* 
+vkeyb - camera motion detection virtual keyboard
+Copyright (C) 2012 Eleni Maria Stea <elene.mst@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XFONT_H_
+#define XFONT_H_
+
+#include <X11/Xlib.h>
+
+#define XFONT_FIRST_CHAR	32
+#define XFONT_NUM_CHARS		95		/* printable ASCII */
+
+struct XFontGlyph {
+	int x, y;				/* top left corner in the atlas */
+	int width, height;
+	int advance;
+	int left, top;			/* origin to top left corner offset */
+};
+
+/* coverage bitmap of the printable ASCII glyphs of an X core font */
+struct XFontAtlas {
+	unsigned char *pixels;	/* width * height, 255 where the glyph is set */
+	int width, height;
+	int ascent, descent;
+	XFontGlyph glyph[XFONT_NUM_CHARS];
+};
+
+/* rasterizes the font with the X server into atlas, returns false if the
+ * font can't be loaded
+ */
+bool xfont_atlas(Display *dpy, const char *name, XFontAtlas *atlas);
+void xfont_free(XFontAtlas *atlas);
+
+#endif	/* XFONT_H_ */